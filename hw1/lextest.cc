@@ -59,12 +59,15 @@ extern void dump_seal_token(ostream& out, int lineno,
 
 int main(int argc, char** argv) {
 	int token;
+	OutputBuffer buf(STDOUT_FILENO);
+	ostream out(&buf);
 	
 	handle_flags(argc,argv);
 
 	while (optind < argc) {
 	    fin = fopen(argv[optind], "r");
 	    if (fin == NULL) {
+		buf.flush();
 		cerr << "Could not open input file " << argv[optind] << endl;
 		exit(1);
 	    }
@@ -77,13 +80,14 @@ int main(int argc, char** argv) {
 	    //
 	    // Scan and print all tokens.
 	    //
-	    cout << "#name \"" << argv[optind] << "\"" << endl;
+	    out << "#name \"" << argv[optind] << "\"" << endl;
 	    while ((token = seal_yylex()) != 0) {
-		dump_seal_token(cout, curr_lineno, token, seal_yylval);
+		dump_seal_token(out, curr_lineno, token, seal_yylval);
 	    }
 	    fclose(fin);
 	    optind++;
 	}
+	buf.flush();
 	exit(0);
 }
 
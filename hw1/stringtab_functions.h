@@ -12,10 +12,23 @@
 #include <stdio.h>
 
 //
-// A string table is implemented a linked list of Entrys.  Each Entry
-// in the list has a unique string.
+// A string table is implemented as a dense array of Entrys plus a hash
+// index over the strings.  Each Entry in the table has a unique string.
 //
 
+//
+// FNV-1a over the first len bytes of s.
+//
+static inline unsigned hash_string(char *s, int len)
+{
+  unsigned h = 2166136261u;
+  for (int i = 0; i < len; i++) {
+    h ^= (unsigned char) s[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
 template <class Elem>
 Elem *StringTable<Elem>::add_string(char *s)
 {
@@ -23,36 +36,93 @@ Elem *StringTable<Elem>::add_string(char *s)
 }
 
 //
-// Add a string requires two steps.  First, the list is searched; if the
-// string is found, a pointer to the existing Entry for that string is 
-// returned.  If the string is not found, a new Entry is created and added
-// to the list.
+// find_bucket returns the bucket holding the entry for (s,len), or the
+// empty bucket where such an entry belongs if there is none.  Collisions
+// are resolved by linear probing.
+//
+template <class Elem>
+int StringTable<Elem>::find_bucket(char *s, int len, unsigned hash)
+{
+  int mask = nbuckets - 1;
+  for (int b = hash & mask; ; b = (b + 1) & mask) {
+    int i = buckets[b] - 1;
+    if (i < 0 || (hashes[i] == hash && tbl[i]->equal_string(s,len)))
+      return b;
+  }
+}
+
+//
+// grow doubles the entry array and the hash index.  The index is rebuilt
+// from the stored hashes, so no string is hashed twice.
+//
+template <class Elem>
+void StringTable<Elem>::grow()
+{
+  int new_capacity = capacity ? capacity * 2 : 256;
+  Elem **new_tbl = new Elem *[new_capacity];
+  unsigned *new_hashes = new unsigned[new_capacity];
+  for (int i = 0; i < index; i++) {
+    new_tbl[i] = tbl[i];
+    new_hashes[i] = hashes[i];
+  }
+  delete [] tbl;
+  delete [] hashes;
+  tbl = new_tbl;
+  hashes = new_hashes;
+  capacity = new_capacity;
+
+  delete [] buckets;
+  nbuckets = capacity * 2;
+  buckets = new int[nbuckets];
+  memset(buckets, 0, nbuckets * sizeof(int));
+  int mask = nbuckets - 1;
+  for (int i = 0; i < index; i++) {
+    int b = hashes[i] & mask;
+    while (buckets[b])
+      b = (b + 1) & mask;
+    buckets[b] = i + 1;
+  }
+}
+
+//
+// Adding a string requires two steps.  First, the hash index is probed;
+// if the string is found, a pointer to the existing Entry for that string
+// is returned.  If the string is not found, a new Entry is created and
+// added to the table.
 //
 template <class Elem>
 Elem *StringTable<Elem>::add_string(char *s, int maxchars)
 {
   int len = min((int) strlen(s),maxchars);
-  for(List<Elem> *l = tbl; l; l = l->tl())
-    if (l->hd()->equal_string(s,len))
-      return l->hd();
+  unsigned hash = hash_string(s,len);
+  if (index == capacity)
+    grow();
+
+  int b = find_bucket(s,len,hash);
+  if (buckets[b])
+    return tbl[buckets[b] - 1];
 
-  Elem *e = new Elem(s,len,index++);
-  tbl = new List<Elem>(e, tbl);
+  Elem *e = new Elem(s,len,index);
+  tbl[index] = e;
+  hashes[index] = hash;
+  buckets[b] = ++index;
   return e;
 }
 
 //
-// To look up a string, the list is scanned until a matching Entry is located.
-// If no such entry is found, an assertion failure occurs.  Thus, this function
-// is used only for strings that one expects to find in the table.
+// To look up a string, the hash index is probed for a matching Entry.
+// If no such entry is found, an assertion failure occurs.  Thus, this
+// function is used only for strings that one expects to find in the table.
 //
 template <class Elem>
 Elem *StringTable<Elem>::lookup_string(char *s)
 {
   int len = strlen(s);
-  for(List<Elem> *l = tbl; l; l = l->tl())
-    if (l->hd()->equal_string(s,len))
-      return l->hd();
+  if (nbuckets) {
+    int b = find_bucket(s,len,hash_string(s,len));
+    if (buckets[b])
+      return tbl[buckets[b] - 1];
+  }
   assert(0);   // fail if string is not found
   return NULL; // to avoid compiler warning
 }
@@ -64,11 +134,8 @@ Elem *StringTable<Elem>::lookup_string(char *s)
 template <class Elem>
 Elem *StringTable<Elem>::lookup(int ind)
 {
-  for(List<Elem> *l = tbl; l; l = l->tl())
-    if (l->hd()->equal_index(ind))
-      return l->hd();
-  assert(0);   // fail if string is not found
-  return NULL; // to avoid compiler warning
+  assert(ind >= 0 && ind < index);   // fail if string is not found
+  return tbl[ind];
 }
 
 //
@@ -103,5 +170,8 @@ int StringTable<Elem>::next(int i)
 template <class Elem>
 void StringTable<Elem>::print()
 {
-  list_print(cerr,tbl);
+  cerr << "[\n";
+  for (int i = 0; i < index; i++)
+    cerr << *tbl[i] << " ";
+  cerr << "]\n";
 }
@@ -13,6 +13,7 @@
 //  This file contains:
 //      fatal_error            print an error message and exit
 //      print_escaped_string   print a string showing escape characters
+//      OutputBuffer           the buffered output sink of a phase
 //      print_seal_token       print a seal token and its semantic value
 //      dump_seal_token        dump a readable token representation
 //      strdup                 duplicate a string (missing from some libraries)
@@ -21,6 +22,10 @@
 
 #include "seal-io.h"     // for cerr, <<, manipulators
 #include <ctype.h>       // for isprint
+#include <errno.h>
+#include <stdio.h>       // for snprintf
+#include <string.h>
+#include <unistd.h>      // for write
 #include "seal-parse.h"  // defines tokens
 #include "stringtab.h"   // Symbol <-> String conversions
 #include "utilities.h"
@@ -40,34 +45,100 @@ void fatal_error(char *msg)
 }
 
 
+//
+// The escape sequence printed for each character, or "" for a character
+// printed as itself.  Unprintable characters are printed as three octal
+// digits.
+//
+static struct EscapeTable {
+  char seq[256][5];
+
+  EscapeTable() {
+    for (int c = 0; c < 256; c++)
+      if (c >= ' ' && c <= '~')
+        seq[c][0] = '\0';
+      else
+        snprintf(seq[c], sizeof(seq[c]), "\\%03o", c);
+    strcpy(seq['\\'], "\\\\");
+    strcpy(seq['\"'], "\\\"");
+    strcpy(seq['\n'], "\\n");
+    strcpy(seq['\t'], "\\t");
+    strcpy(seq['\b'], "\\b");
+    strcpy(seq['\f'], "\\f");
+  }
+} escapes;
+
 void print_escaped_string(ostream& str, const char *s)
 {
-  while (*s) {
-    switch (*s) {
-    case '\\' : str << "\\\\"; break;
-    case '\"' : str << "\\\""; break;
-    case '\n' : str << "\\n"; break;
-    case '\t' : str << "\\t"; break;
-    case '\b' : str << "\\b"; break;
-    case '\f' : str << "\\f"; break;
+  const char *run = s;     // characters not yet written, printed as is
+  for (; *s; s++) {
+    const char *seq = escapes.seq[(unsigned char) *s];
+    if (seq[0] == '\0')
+      continue;
+    str.write(run, s - run);
+    str << seq;
+    run = s + 1;
+  }
+  str.write(run, s - run);
+}
+
+OutputBuffer::OutputBuffer(int fd) : fd(fd), buf(NULL), capacity(0)
+{
+  reserve(1 << 16);
+}
 
-    default:
-      if (isprint(*s))
-	str << *s;
-      else 
-	// 
-	// Unprintable characters are printed using octal equivalents.
-	// To get the sign of the octal number correct, the character
-	// must be cast to an unsigned char before coverting it to an
-	// integer.
-	//
-	str << '\\' << oct << setfill('0') << setw(3)
-	    << (int) ((unsigned char) (*s))
-	    << dec << setfill(' ');
-      break;
-    }
-    s++;
+OutputBuffer::~OutputBuffer()
+{
+  flush();
+  free(buf);
+}
+
+// Make room for n more characters.
+void OutputBuffer::reserve(size_t n)
+{
+  size_t used = pptr() - pbase();
+  if (used + n <= capacity)
+    return;
+  while (capacity < used + n)
+    capacity = capacity ? 2 * capacity : n;
+  buf = (char *) realloc(buf, capacity);
+  if (buf == NULL)
+    fatal_error("out of memory for the output buffer\n");
+  setp(buf, buf + capacity);
+  pbump(used);
+}
+
+OutputBuffer::int_type OutputBuffer::overflow(int_type c)
+{
+  if (traits_type::eq_int_type(c, traits_type::eof()))
+    return traits_type::not_eof(c);
+  reserve(1);
+  *pptr() = traits_type::to_char_type(c);
+  pbump(1);
+  return c;
+}
+
+std::streamsize OutputBuffer::xsputn(const char *s, std::streamsize n)
+{
+  reserve(n);
+  memcpy(pptr(), s, n);
+  pbump(n);
+  return n;
+}
+
+bool OutputBuffer::flush()
+{
+  const char *p = pbase();
+  while (p < pptr()) {
+    ssize_t n = write(fd, p, pptr() - p);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    p += n;
   }
+  setp(buf, buf + capacity);
+  return true;
 }
 
 //
@@ -55,8 +55,12 @@ int main(int argc, char *argv[]) {
         cerr << "ast_root must be initialized.\n";
 	    exit(1);
     }
-    ast_root->dump_with_types(cout,0);
+    OutputBuffer buf(STDOUT_FILENO);
+    ostream out(&buf);
+    ast_root->dump_with_types(out,0);
+    buf.flush();
     fclose(fin);
+    ast_arena.release();
     return 0;
 }
 
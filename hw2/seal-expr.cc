@@ -373,7 +373,7 @@ Exprs single_Exprs(Expr e)
 }
 Exprs append_Exprs(Exprs p1, Exprs p2)
 {
-   return new append_node<Expr>(p1, p2);
+   return list_node<Expr>::append(p1, p2);
 }
 
 
@@ -387,7 +387,7 @@ Actuals single_Actuals(Actual e)
 }
 Actuals append_Actuals(Actuals p1, Actuals p2)
 {
-   return new append_node<Actual>(p1, p2);
+   return list_node<Actual>::append(p1, p2);
 }
 
 
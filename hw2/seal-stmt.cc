@@ -118,7 +118,7 @@ Stmts single_Stmts(Stmt e)
 }
 Stmts append_Stmts(Stmts p1, Stmts p2)
 {
-   return new append_node<Stmt>(p1, p2);
+   return list_node<Stmt>::append(p1, p2);
 }
 
 
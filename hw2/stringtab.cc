@@ -19,9 +19,32 @@ template class StringTable<StringEntry>;
 template class StringTable<IntEntry>;
 template class StringTable<FloatEntry>;
 
+//
+// The characters of all Entrys are carved out of large shared blocks
+// rather than allocated one string at a time.  Like the Entrys that
+// point into them, the blocks live as long as the compiler does.
+//
+#define POOL_BLOCK_SIZE 65536
+
+static char *pool_next = NULL;
+static char *pool_end = NULL;
+
+static char *pool_alloc(int size)
+{
+  if (size > POOL_BLOCK_SIZE / 4)
+    return new char [size];
+  if (pool_end - pool_next < size) {
+    pool_next = new char [POOL_BLOCK_SIZE];
+    pool_end = pool_next + POOL_BLOCK_SIZE;
+  }
+  char *p = pool_next;
+  pool_next += size;
+  return p;
+}
+
 Entry::Entry(char *s, int l, int i) : len(l), index(i) {
-  str = new char [len+1];
-  strncpy(str, s, len);
+  str = pool_alloc(len+1);
+  memcpy(str, s, len);
   str[len] = '\0';
 }
 
@@ -18,6 +18,9 @@
 /* line number to assign to the current node being constructed */
 int node_lineno = 1;
 
+/* owns every tree node of the current compilation */
+Arena ast_arena;
+
 ///////////////////////////////////////////////////////////////////////////
 //
 // tree_node::tree_node
@@ -0,0 +1,100 @@
+//
+// See copyright.h for copyright notice and limitation of liability
+// and disclaimer of warranty provisions.
+//
+#include "copyright.h"
+
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+//////////////////////////////////////////////////////////////////////
+//
+//  arena.h
+//
+//  A bump-pointer allocator.  Memory is handed out from large blocks
+//  in allocation order and is never freed piecemeal; release() gives
+//  back every block at once.  Objects placed in an arena must not need
+//  their destructors run.
+//
+//    void *allocate(size_t n)
+//      returns n bytes aligned for any type.
+//
+//    T *make(const T &v)
+//      copies v into the arena and returns a pointer to the copy.
+//
+//    void release()
+//      frees every block.  All pointers into the arena become invalid.
+//
+//////////////////////////////////////////////////////////////////////
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <new>
+
+class Arena {
+private:
+   static const size_t block_size = 1 << 16;
+   static const size_t alignment = 16;
+
+   struct Block {
+      Block *next;
+   };
+
+   Block *blocks;     // every block obtained so far, newest first
+   char *next;        // first free byte of the newest block
+   char *end;         // end of the newest block
+
+   // Start a new block of at least n usable bytes.
+   void new_block(size_t n)
+   {
+      size_t header = (sizeof(Block) + alignment - 1) & ~(size_t) (alignment - 1);
+      size_t size = header + (n > block_size ? n : (size_t) block_size);
+      Block *b = (Block *) malloc(size);
+      if (b == NULL)
+         throw std::bad_alloc();
+      b->next = blocks;
+      blocks = b;
+      next = (char *) b + header;
+      end = (char *) b + size;
+   }
+
+   Arena(const Arena &);
+   Arena &operator =(const Arena &);
+public:
+   Arena() : blocks(NULL), next(NULL), end(NULL) { }
+   ~Arena() { release(); }
+
+   void *allocate(size_t n)
+   {
+      n = (n + alignment - 1) & ~(size_t) (alignment - 1);
+      if ((size_t) (end - next) < n)
+         new_block(n);
+      void *p = next;
+      next += n;
+      return p;
+   }
+
+   template <class T> T *make(const T &v)
+   {
+      return new (allocate(sizeof(T))) T(v);
+   }
+
+   void release()
+   {
+      while (blocks) {
+         Block *b = blocks;
+         blocks = b->next;
+         free(b);
+      }
+      next = end = NULL;
+   }
+};
+
+//
+// ast_arena owns the nodes of the abstract syntax tree, their lists, and
+// the data the compiler's symbol tables point to.  It lives for exactly
+// one compilation.
+//
+extern Arena ast_arena;
+
+#endif
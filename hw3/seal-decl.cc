@@ -58,7 +58,7 @@ Decls single_Decls(Decl e)
 }
 Decls append_Decls(Decls p1, Decls p2)
 {
-   return new append_node<Decl>(p1, p2);
+   return list_node<Decl>::append(p1, p2);
 }
 
 
@@ -72,7 +72,7 @@ VariableDecls single_VariableDecls(VariableDecl e)
 }
 VariableDecls append_VariableDecls(VariableDecls p1, VariableDecls p2)
 {
-   return new append_node<VariableDecl>(p1, p2);
+   return list_node<VariableDecl>::append(p1, p2);
 }
 
 
@@ -86,7 +86,7 @@ Variables single_Variables(Variable e)
 }
 Variables append_Variables(Variables p1, Variables p2)
 {
-   return new append_node<Variable>(p1, p2);
+   return list_node<Variable>::append(p1, p2);
 }
 
 
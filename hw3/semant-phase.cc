@@ -3,6 +3,7 @@
 #include "seal-decl.h"
 #include "seal-expr.h"
 #include "seal-stmt.h"
+#include "utilities.h"
 
 extern Program ast_root;      // root of the abstract syntax tree
 FILE *fin;                    // input file
@@ -27,7 +28,11 @@ int main(int argc, char *argv[]) {
     exit(-1);
   }
   ast_root->semant();
-  ast_root->dump_with_types(cout,0);
+  OutputBuffer buf(STDOUT_FILENO);
+  ostream out(&buf);
+  ast_root->dump_with_types(out,0);
+  buf.flush();
   fclose(fin);
+  ast_arena.release();
 }
 
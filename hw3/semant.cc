@@ -179,7 +179,7 @@ void VariableDecl_class::check() {
         return;
     }
     localVarMap[name] = type;
-    objectEnv.addid(name, new Symbol(type));
+    objectEnv.addid(name, ast_arena.make(type));
     
 }
 
@@ -246,7 +246,7 @@ void CallDecl_class::check() {
             semant_error(this) << "Function " << callName << "'s parameter" << paraName << " has an invalid type Void " << std::endl;
             continue;
         }
-        objectEnv.addid(paraName, new Symbol(paraType));
+        objectEnv.addid(paraName, ast_arena.make(paraType));
         paraVarMap[paraName] = paraType;
     } 
     // check main function
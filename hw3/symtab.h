@@ -14,6 +14,9 @@
 #ifndef _SYMTAB_H_
 #define _SYMTAB_H_
 
+#include <deque>
+#include <functional>
+#include <vector>
 #include "list.h"
 
 //
@@ -35,54 +38,100 @@ public:
 //
 // SymbolTable<SYM,DAT> describes a symbol table mapping symbols of
 //    type `SYM' to data of type `DAT *'.  It is implemented as a
-//    list of lists of `SymtabEntry<SYM,DAT> *'.  The inner list is
-//    a scope, a mapping from symbols to data, and the outer list is
-//    a list of scopes. 
-//
-//    `tbl' points to the current top scope.
-//
-//    `enterscope' makes the table point to a new scope whose parent
-//       is the scope it pointed to previously.
-//
-//    `exitscope' makes the table point to the parent scope of the
-//        current scope.  Note that the old child scope is not
-//        deallocated.  One may save the state of a symbol table
-//        at a given point by copying it with `operator ='
-//
-//    `addid(s,i)' adds a symbol table entry to the current scope of
-//        the symbol table mapping symbol `s' to data `d'.  The old
-//        top scope isn't modified; a new scope is created whose
-//        entry list is the new entry followed by the old entry list,
-//        and whose tail is the old top scope's parent.  The table
-//        is made to point to this new scope.
-//
-//    `lookup(s)' looks for the symbol `s', starting at the top scope
-//        and proceeding down the list of scopes until either an
-//        entry is found whose `get_id()' equals `s', or the end of
-//        the root scope is reached.  It returns the data item
-//        associated with the entry, or NULL if no such entry exists.
-//
-//    
-//    `probe(s)' checks the top scope for an entry whose `get_id()'
-//        equals `s', and returns the entry's `get_info()' if
-//        found, and NULL otherwise.
+//    single hash index from each symbol to the stack of its bindings,
+//    plus an undo log recording every binding in the order it was made.
+//
+//    `log' is the undo log.  Each binding remembers the binding of
+//        the same symbol it shadows (or -1), so the bindings of one
+//        symbol form a stack threaded through the log.
+//
+//    `marks' holds, for every open scope, the length of the log when
+//        that scope was entered.
+//
+//    `keys'/`heads' form an open-addressing hash index: `heads[b]' is
+//        the position in the log of the innermost binding of `keys[b]',
+//        or -1 if that symbol is currently unbound.  A symbol keeps its
+//        bucket once it has one, so nothing is ever removed from the
+//        index and no tombstones are needed.
+//
+//    `enterscope' pushes a new mark.  No memory is allocated.
+//
+//    `exitscope' pops the bindings made since the last mark off the
+//        log, restoring each symbol's previous binding.  The cost is
+//        proportional to the number of bindings in the scope.
+//
+//    `addid(s,i)' appends a binding of `s' to `i' to the log and makes
+//        it the innermost binding of `s'.
+//
+//    `lookup(s)' returns the data of the innermost binding of `s' in
+//        any scope, or NULL if there is none.
+//
+//    `probe(s)' returns the data of the innermost binding of `s' if
+//        that binding was made in the current scope, and NULL otherwise.
 //
 //    `dump()' prints the symbols in the symbol table.
 //
+//    Assigning one table to another copies its contents, so the state
+//    of a table can still be saved with `operator ='.
+//
 
 template <class SYM, class DAT>
 class SymbolTable
 {
    typedef SymtabEntry<SYM,DAT> ScopeEntry;
-   typedef List<ScopeEntry> Scope;
-   typedef List<Scope> ScopeList;
+
+   struct Binding {
+      ScopeEntry entry;
+      int shadowed;     // log position of the binding this one hides, or -1
+      int depth;        // number of open scopes when the binding was made
+      Binding(SYM s, DAT *i, int sh, int d) : entry(s,i), shadowed(sh), depth(d) { }
+   };
 private:
-   ScopeList  *tbl;
-public:
-   SymbolTable(): tbl(NULL) { }     // create a new symbol table
+   std::deque<Binding> log;   // deque: addid's result stays valid as the log grows
+   std::vector<int> marks;
+   std::vector<SYM> keys;
+   std::vector<int> heads;
+   int nkeys;
+
+   // Find the bucket of `s', or the empty bucket it would go in.
+   int bucket(SYM s) const
+   {
+       size_t mask = keys.size() - 1;
+       size_t b = std::hash<SYM>()(s);
+       b = (b ^ (b >> 16)) * 0x9E3779B1u;
+       for (b &= mask; heads[b] != -2 && !(keys[b] == s); b = (b + 1) & mask)
+           ;
+       return (int) b;
+   }
 
-   // Create pointer to current symbol table.
-   SymbolTable &operator =(const SymbolTable &s) { tbl = s.tbl; return *this; }
+   // Double the hash index; a bucket with head -2 has never been used.
+   void grow()
+   {
+       std::vector<SYM> old_keys;
+       std::vector<int> old_heads;
+       old_keys.swap(keys);
+       old_heads.swap(heads);
+       size_t size = old_keys.empty() ? 64 : old_keys.size() * 2;
+       keys.assign(size, SYM());
+       heads.assign(size, -2);
+       for (size_t i = 0; i < old_keys.size(); i++) {
+           if (old_heads[i] != -2) {
+               int b = bucket(old_keys[i]);
+               keys[b] = old_keys[i];
+               heads[b] = old_heads[i];
+           }
+       }
+   }
+
+   // Position in the log of the innermost binding of `s', or -1.
+   int head(SYM s) const
+   {
+       if (keys.empty()) return -1;
+       int b = bucket(s);
+       return heads[b] == -2 ? -1 : heads[b];
+   }
+public:
+   SymbolTable(): nkeys(0) { }     // create a new symbol table
 
    void fatal_error(char * msg)
    {
@@ -90,36 +139,43 @@ public:
      exit(1);
    } 
 
-   // Enter a new scope.  A symbol table is organized as a list of
-   // lists.  The head of the list is the innermost scope, the tail
-   // holds the outer scopes.  A scope must be entered before anything
-   // can be added to the table.
-
+   // Enter a new scope.  A scope must be entered before anything can
+   // be added to the table.
    void enterscope()
    {
-       // The cast of NULL is required for template instantiation to work
-       // correctly.
-       tbl = new ScopeList((Scope *) NULL, tbl);
+       marks.push_back((int) log.size());
    }
 
-   // Pop the first scope off of the symbol table.
+   // Pop the innermost scope, undoing every binding made in it.
    void exitscope()
    {
        // It is an error to exit a scope that doesn't exist.
-       if (tbl == NULL) {
+       if (marks.empty()) {
 	   fatal_error("exitscope: Can't remove scope from an empty symbol table.");
        }
-       tbl = tbl->tl();
+       while ((int) log.size() > marks.back()) {
+           Binding &top = log.back();
+           heads[bucket(top.entry.get_id())] = top.shadowed;
+           log.pop_back();
+       }
+       marks.pop_back();
    }
 
    // Add an item to the symbol table.
    ScopeEntry *addid(SYM s, DAT *i)
    {
        // There must be at least one scope to add a symbol.
-       if (tbl == NULL) fatal_error("addid: Can't add a symbol without a scope.");
-       ScopeEntry * se = new ScopeEntry(s,i);
-       tbl = new ScopeList(new Scope(se, tbl->hd()), tbl->tl());
-       return(se);
+       if (marks.empty()) fatal_error("addid: Can't add a symbol without a scope.");
+       if (2 * (nkeys + 1) > (int) keys.size()) grow();
+       int b = bucket(s);
+       if (heads[b] == -2) {
+           keys[b] = s;
+           heads[b] = -1;
+           nkeys++;
+       }
+       log.push_back(Binding(s, i, heads[b], (int) marks.size()));
+       heads[b] = (int) log.size() - 1;
+       return &log.back().entry;
    }
    
    // Lookup an item through all scopes of the symbol table.  If found
@@ -128,38 +184,31 @@ public:
 
    DAT * lookup(SYM s)
    {
-       for(ScopeList *i = tbl; i != NULL; i=i->tl()) {
-	   for( Scope *j = i->hd(); j != NULL; j = j->tl()) {
-	       if (s == j->hd()->get_id()) {
-		   return (j->hd()->get_info());
-	       }
-	   }
-       }
-       return NULL;
+       int h = head(s);
+       return h < 0 ? NULL : log[h].entry.get_info();
    }
 
    // probe the symbol table.  Check the top scope (only) for the item
    // 's'.  If found, return the information field.  If not return NULL.
    DAT *probe(SYM s)
    {
-       if (tbl == NULL) {
+       if (marks.empty()) {
 	   fatal_error("probe: No scope in symbol table.");
        }
-       for(Scope *i = tbl->hd(); i != NULL; i = i->tl()) {
-	   if (s == i->hd()->get_id()) {
-	       return(i->hd()->get_info());
-	   }
-       }
-       return(NULL);
+       int h = head(s);
+       if (h < 0 || log[h].depth != (int) marks.size())
+           return NULL;
+       return log[h].entry.get_info();
    }
 
    // Prints out the contents of the symbol table  
    void dump()
    {
-      for(ScopeList *i = tbl; i != NULL; i = i->tl()) {
+      int pos = (int) log.size();
+      for (int d = (int) marks.size() - 1; d >= 0; d--) {
          cerr << "\nScope: \n";
-         for(Scope *j = i->hd(); j != NULL; j = j->tl()) {
-            cerr << "  " << j->hd()->get_id() << endl;
+         for (; pos > marks[d]; pos--) {
+            cerr << "  " << log[pos - 1].entry.get_id() << endl;
          }
       }
    }
@@ -17,6 +17,7 @@
 
 #include "stringtab.h"
 #include "seal-io.h"
+#include "arena.h"
 
 /////////////////////////////////////////////////////////////////////
 //
@@ -47,6 +48,11 @@
 //           sets the line number and type of "this" to the values in
 //           the argument tree_node.  Returns "this".
 //
+//   Tree nodes are allocated in ast_arena (see arena.h), so nodes are
+//   laid out in memory in the order they are built and are all released
+//   together at the end of a compilation.  delete on a tree node is a
+//   no-op.
+//
 //
 ////////////////////////////////////////////////////////////////////////////
 class tree_node {
@@ -59,6 +65,9 @@ public:
     virtual void dump(ostream& stream, int n) = 0;
     int get_line_number();
     tree_node *set(tree_node *);
+
+    static void *operator new(size_t size) { return ast_arena.allocate(size); }
+    static void operator delete(void *) { }
 };
 
 ///////////////////////////////////////////////////////////////////
@@ -104,7 +113,10 @@ public:
 //
 //     These three functions construct an empty list, a list of one element,
 //     and append two lists, respectively.  Note that the functions are static;
-//     there is no "this" parameter.  Example uses:
+//     there is no "this" parameter.  append returns a flat_list_node, so
+//     nth and len on its result take constant time, and appending to the
+//     end of a list built by append takes amortized constant time.
+//     Example uses:
 //
 //     list_node<Elem>::nil();
 //     list_node<Elem>::single(e);     where "e" has type Elem
@@ -174,6 +186,43 @@ public:
 };
 
 
+//
+// A flat_list_node stores its elements in an array shared with the lists
+// it was appended from.  Each node sees the first `length' elements of the
+// array.  Appending to the node that sees the whole array grows the array
+// in place; appending to any other node copies its prefix first.  Lists
+// therefore stay persistent, as with append_node, while the usual
+// left-to-right building pattern
+//
+//     l = append(l, single(e));
+//
+// does no copying.
+//
+template <class Elem> struct list_buffer {
+    Elem *elems;
+    int size;
+    int capacity;
+};
+
+template <class Elem> class flat_list_node : public list_node<Elem> {
+private:
+    list_buffer<Elem> *buf;
+    int length;
+public:
+    flat_list_node(list_buffer<Elem> *b, int l) {
+	buf = b;
+	length = l;
+    }
+    list_node<Elem> *copy_list();
+    int len();
+    Elem nth(int n);
+    Elem nth_length(int n, int &len);
+    void dump(ostream& stream, int n);
+
+    static flat_list_node<Elem> *concat(list_node<Elem> *l1, list_node<Elem> *l2);
+};
+
+
 template <class Elem> single_list_node<Elem> *list(Elem x);
 template <class Elem> append_node<Elem> *cons(Elem x, list_node<Elem> *l);
 template <class Elem> append_node<Elem> *xcons(list_node<Elem> *l, Elem x);
@@ -182,7 +231,7 @@ template <class Elem> append_node<Elem> *xcons(list_node<Elem> *l, Elem x);
 template <class Elem> list_node<Elem> *list_node<Elem>::nil() { return new nil_node<Elem>(); }
 template <class Elem> list_node<Elem> *list_node<Elem>::single(Elem e) { return new single_list_node<Elem>(e); }
 template <class Elem> list_node<Elem> *list_node<Elem>::append(list_node<Elem> *l1,list_node<Elem> *l2) {
-   return new append_node<Elem>(l1,l2);
+   return flat_list_node<Elem>::concat(l1,l2);
 }
 
 
@@ -396,6 +445,119 @@ template <class Elem> void append_node<Elem>::dump(ostream& stream, int n)
 }
 
 
+///////////////////////////////////////////////////////////////////////////
+//
+// flat_list_node::concat
+//
+// return a flat list of the elements of l1 followed by those of l2
+//
+///////////////////////////////////////////////////////////////////////////
+template <class Elem> flat_list_node<Elem> *flat_list_node<Elem>::concat(list_node<Elem> *l1, list_node<Elem> *l2)
+{
+    flat_list_node<Elem> *f1 = dynamic_cast<flat_list_node<Elem> *>(l1);
+    int len1 = l1->len();
+    int len2 = l2->len();
+    list_buffer<Elem> *b;
+
+    if (f1 && f1->buf->size == len1) {
+	b = f1->buf;
+    } else {
+	b = (list_buffer<Elem> *) ast_arena.allocate(sizeof(list_buffer<Elem>));
+	b->elems = NULL;
+	b->size = b->capacity = 0;
+    }
+    if (b->capacity < len1 + len2) {
+	// The old array is left behind in the arena; doubling bounds the waste.
+	int capacity = b->capacity ? b->capacity : 4;
+	while (capacity < len1 + len2)
+	    capacity *= 2;
+	Elem *elems = (Elem *) ast_arena.allocate(capacity * sizeof(Elem));
+	for (int i = 0; i < b->size; i++)
+	    elems[i] = b->elems[i];
+	b->elems = elems;
+	b->capacity = capacity;
+    }
+    for (int i = b->size; i < len1; i++)
+	b->elems[i] = l1->nth(i);
+    for (int i = 0; i < len2; i++)
+	b->elems[len1 + i] = l2->nth(i);
+    b->size = len1 + len2;
+    return new flat_list_node<Elem>(b, b->size);
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// flat_list_node::copy_list
+//
+// return the deep copy of the flat_list_node
+//
+///////////////////////////////////////////////////////////////////////////
+template <class Elem> list_node<Elem> *flat_list_node<Elem>::copy_list()
+{
+    list_buffer<Elem> *b = (list_buffer<Elem> *) ast_arena.allocate(sizeof(list_buffer<Elem>));
+    b->elems = (Elem *) ast_arena.allocate((length ? length : 1) * sizeof(Elem));
+    b->size = b->capacity = length;
+    for (int i = 0; i < length; i++)
+	b->elems[i] = (Elem) buf->elems[i]->copy();
+    return new flat_list_node<Elem>(b, length);
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// flat_list_node::len
+//
+// return the length of the flat_list_node
+//
+///////////////////////////////////////////////////////////////////////////
+template <class Elem> int flat_list_node<Elem>::len()
+{
+    return length;
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// flat_list_node::nth_length
+//
+// return the nth element on the list
+//
+///////////////////////////////////////////////////////////////////////////
+template <class Elem> Elem flat_list_node<Elem>::nth_length(int n, int &len)
+{
+    len = length;
+    if (n < 0 || n >= length)
+	return NULL;
+    return buf->elems[n];
+}
+
+template <class Elem> Elem flat_list_node<Elem>::nth(int n)
+{
+    if (n < 0 || n >= length) {
+	cerr << "error: outside the range of the list\n";
+	exit(1);
+    }
+    return buf->elems[n];
+}
+
+
+///////////////////////////////////////////////////////////////////////////
+//
+// flat_list_node::dump
+//
+// dump for list node
+//
+///////////////////////////////////////////////////////////////////////////
+template <class Elem> void flat_list_node<Elem>::dump(ostream& stream, int n)
+{
+    stream << pad(n) << "list\n";
+    for (int i = 0; i < length; i++)
+      buf->elems[i]->dump(stream, n+2);
+    stream << pad(n) << "(end_of_list)\n";
+}
+
+
 ///////////////////////////////////////////////////////////////////////////
 //
 // list
@@ -1,14 +1,17 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <string.h>
+#include <fcntl.h>
 #include "seal-io.h"  //includes iostream
 #include "seal-decl.h"
 #include "seal-stmt.h"
 #include "seal-expr.h"
 #include "cgen_gc.h"
+#include "utilities.h"
 
 extern int optind;            // for option processing
 extern char *out_filename;    // name of output assembly
+extern int emit_ir;           // -emit-ir: output the IR instead
 extern Program ast_root;             // root of the abstract syntax tree
 extern int omerrs;            // syntax errors
 extern int semant_errors;     // semant errors
@@ -22,21 +25,25 @@ void handle_flags(int argc, char *argv[]);
 
 int main(int argc, char *argv[]) {
   int firstfile_index;
+  handle_flags(argc,argv);
+  firstfile_index = optind;
+  if (optind >= argc) {
+		cerr << "No input file" << endl;
+		exit(1);
+  }
   fin = fopen(argv[optind], "r");
 	    if (fin == NULL) {
 		cerr << "Could not open input file " << argv[optind] << endl;
 		exit(1);
 	}
   curr_lineno = 1;
-  handle_flags(argc,argv);
-  firstfile_index = optind;
 
-  if (!out_filename && optind < argc) {   // no -o option
+  if (!out_filename) {   // no -o option
       char *dot = strrchr(argv[optind], '.');
       if (dot) *dot = '\0'; // strip off file extension
       out_filename = new char[strlen(argv[optind])+8];
       strcpy(out_filename, argv[optind]);
-      strcat(out_filename, ".s");
+      strcat(out_filename, emit_ir ? ".ir" : ".s");
   }
   // 
   // Don't touch the output file until we know that earlier phases of the
@@ -52,16 +59,27 @@ int main(int argc, char *argv[]) {
     cerr << "semant analyze failed. Please make sure semant parser passed." << endl;
     exit(-1);
   }
+  int fd = STDOUT_FILENO;
   if (out_filename) {
-      ofstream s(out_filename);
-      if (!s) {
+      fd = open(out_filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+      if (fd < 0) {
         cerr << "Cannot open output file " << out_filename << endl;
         exit(1);
       }
+  }
+  {
+      OutputBuffer buf(fd);
+      ostream s(&buf);
       ast_root->cgen(s);
-  } else {
-      ast_root->cgen(cout);
+      if (!buf.flush()) {
+        cerr << "Cannot write output "
+             << (out_filename ? out_filename : "to standard output") << endl;
+        exit(1);
+      }
   }
+  if (fd != STDOUT_FILENO)
+      close(fd);
   fclose(fin);
+  ast_arena.release();
 }
 
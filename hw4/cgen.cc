@@ -1,8 +1,9 @@
 
 //**************************************************************
 //
-// Code generator SKELETON
-//
+// The code generator.  Each function's AST is lowered into the IR
+// of ir.h, optimized under -O (see opt.h), and emitted by the
+// x86-64 backend of x86.h.
 //
 //**************************************************************
 
@@ -13,16 +14,12 @@ using namespace std;
 
 extern void emit_string_constant(ostream &str, char *s);
 extern int cgen_debug;
-
-static char *CALL_REGS[] = {RDI, RSI, RDX, RCX, R8, R9};
-static char *CALL_XMM[] = {XMM0, XMM1, XMM2, XMM3};
+extern int cgen_optimize;
+extern int emit_ir;
 
 void cgen_helper(Decls decls, ostream &s);
 void code(Decls decls, ostream &s);
 
-// 存储变量名和内存
-typedef SymbolTable<Symbol, int> ObjectEnv;
-ObjectEnv objectmap;
 //////////////////////////////////////////////////////////////////
 //
 //
@@ -68,11 +65,8 @@ static void initialize_constants(void)
   print = idtable.add_string("printf");
 }
 
-int offset = 0;
-int tadd = 0;
-int num_label = 0;
-int continuepos = 0;
-int breakpos = 0;
+// the types of the global variables
+static std::map<Symbol, IRType> global_types;
 
 //*********************************************************
 //
@@ -91,274 +85,112 @@ void Program_class::cgen(ostream &os)
 
   os << "\n# end of generated code\n";
 }
-
-//////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
 //
-//  emit_* procedures
+// Lowering
 //
-//  emit_X  writes code for operation "X" to the output stream.
-//  There is an emit_X for each opcode X, as well as emit_ functions
-//  for generating names according to the naming conventions (see emit.h)
-//  and calls to support functions defined in the trap handler.
+// Each function is lowered into the IR of ir.h, which the backend in x86.cc
+// turns into assembly.  Stmt::code appends a statement's instructions to
+// the builder's current block, and Expr::code leaves the expression's value
+// in the builder's result: a constant, the vreg of a local variable, or a
+// new vreg.
 //
-//  Register names and addresses are passed as strings.  See `emit.h'
-//  for symbolic names you can use to refer to the strings.
+// Where only the truth of a Bool expression matters -- the condition of an
+// if, while or for -- it is lowered by code_cond(if_true, if_false), which
+// ends the current block with a branch to one of the two.  A comparison is
+// a single conditional branch, ! swaps the targets, and && / || branch on
+// their left operand to a block evaluating the right one, so that it is
+// skipped once the left one decides the result.  Where a && or || is
+// needed as a value, code_cond_value branches to blocks setting it to 1
+// or 0.
 //
-//////////////////////////////////////////////////////////////////////////////
-
-static void emit_mov(const char *source, const char *dest, ostream &s)
-{
-  s << MOV << source << COMMA << dest << endl;
-}
-
-static void emit_rmmov(const char *source_reg, int offset, const char *base_reg, ostream &s)
-{
-  s << MOV << source_reg << COMMA << offset << "(" << base_reg << ")"
-    << endl;
-}
-
-static void emit_mrmov(const char *base_reg, int offset, const char *dest_reg, ostream &s)
-{
-  s << MOV << offset << "(" << base_reg << ")" << COMMA << dest_reg
-    << endl;
-}
-
-static void emit_irmov(const char *immidiate, const char *dest_reg, ostream &s)
-{
-  s << MOV << "$" << immidiate << COMMA << dest_reg
-    << endl;
-}
-
-static void emit_irmovl(const char *immidiate, const char *dest_reg, ostream &s)
-{
-  s << MOVL << "$" << immidiate << COMMA << dest_reg
-    << endl;
-}
-
-static void emit_immov(const char *immidiate, int offset, const char *base_reg, ostream &s)
-{
-  s << MOV << "$" << immidiate << COMMA << "(" << offset << ")" << base_reg
-    << endl;
-}
-
-static void emit_add(const char *source_reg, const char *dest_reg, ostream &s)
-{
-  s << ADD << source_reg << COMMA << dest_reg << endl;
-}
-
-static void emit_sub(const char *source_reg, const char *dest_reg, ostream &s)
-{
-  s << SUB << source_reg << COMMA << dest_reg << endl;
-}
-
-static void emit_mul(const char *source_reg, const char *dest_reg, ostream &s)
-{
-  s << MUL << source_reg << COMMA << dest_reg << endl;
-}
-
-static void emit_div(const char *dest_reg, ostream &s)
-{
-  s << DIV << dest_reg << endl;
-}
-
-static void emit_cqto(ostream &s)
-{
-  s << CQTO << endl;
-}
-
-static void emit_neg(const char *dest_reg, ostream &s)
-{
-  s << NEG << dest_reg << endl;
-}
-
-static void emit_and(const char *source_reg, const char *dest_reg, ostream &s)
-{
-  s << AND << source_reg << COMMA << dest_reg << endl;
-}
-
-static void emit_or(const char *source_reg, const char *dest_reg, ostream &s)
-{
-  s << OR << source_reg << COMMA << dest_reg << endl;
-}
-
-static void emit_xor(const char *source_reg, const char *dest_reg, ostream &s)
-{
-  s << XOR << source_reg << COMMA << dest_reg << endl;
-}
-
-static void emit_not(const char *dest_reg, ostream &s)
-{
-  s << NOT << " " << dest_reg << endl;
-}
-
-static void emit_movsd(const char *source, const char *dest, ostream &s)
-{
-  s << MOVSD << source << COMMA << dest << endl;
-}
-
-static void emit_movaps(const char *source, const char *dest, ostream &s)
-{
-  s << MOVAPS << source << COMMA << dest << endl;
-}
-
-static void emit_addsd(const char *source_reg, const char *dest_reg, ostream &s)
-{
-  s << ADDSD << source_reg << COMMA << dest_reg << endl;
-}
-
-static void emit_subsd(const char *source_reg, const char *dest_reg, ostream &s)
-{
-  s << SUBSD << source_reg << COMMA << dest_reg << endl;
-}
-
-static void emit_mulsd(const char *source_reg, const char *dest_reg, ostream &s)
-{
-  s << MULSD << source_reg << COMMA << dest_reg << endl;
-}
-
-static void emit_divsd(const char *source_reg, const char *dest_reg, ostream &s)
-{
-  s << DIVSD << source_reg << COMMA << dest_reg << endl;
-}
-
-static void emit_cmp(const char *source_reg, const char *dest_reg, ostream &s)
-{
-  s << CMP << source_reg << COMMA << dest_reg << endl;
-}
-
-static void emit_test(const char *source_reg, const char *dest_reg, ostream &s)
-{
-  s << TEST << source_reg << COMMA << dest_reg << endl;
-}
-
-static void emit_ucompisd(const char *source_reg, const char *dest_reg, ostream &s)
-{
-  s << UCOMPISD << source_reg << COMMA << dest_reg << endl;
-}
-
-static void emit_xorpd(const char *source_reg, const char *dest_reg, ostream &s)
-{
-  s << XORPD << source_reg << COMMA << dest_reg << endl;
-}
-static void emit_jmp(const char *dest, ostream &s)
-{
-  s << JMP << " " << dest << endl;
-}
-
-static void emit_jl(const char *dest, ostream &s)
-{
-  s << JL << " " << dest << endl;
-}
-
-static void emit_jle(const char *dest, ostream &s)
-{
-  s << JLE << " " << dest << endl;
-}
-
-static void emit_je(const char *dest, ostream &s)
-{
-  s << JE << " " << dest << endl;
-}
-
-static void emit_jne(const char *dest, ostream &s)
-{
-  s << JNE << " " << dest << endl;
-}
-
-static void emit_jg(const char *dest, ostream &s)
-{
-  s << JG << " " << dest << endl;
-}
-
-static void emit_jge(const char *dest, ostream &s)
-{
-  s << JGE << " " << dest << endl;
-}
-
-static void emit_jb(const char *dest, ostream &s)
-{
-  s << JB << " " << dest << endl;
-}
-
-static void emit_jbe(const char *dest, ostream &s)
-{
-  s << JBE << " " << dest << endl;
-}
-
-static void emit_ja(const char *dest, ostream &s)
-{
-  s << JA << " " << dest << endl;
-}
-
-static void emit_jae(const char *dest, ostream &s)
-{
-  s << JAE << " " << dest << endl;
-}
-
-static void emit_jp(const char *dest, ostream &s)
-{
-  s << JP << " " << dest << endl;
-}
-
-static void emit_jz(const char *dest, ostream &s)
-{
-  s << JZ << " " << dest << endl;
-}
-
-static void emit_jnz(const char *dest, ostream &s)
-{
-  s << JNZ << " " << dest << endl;
-}
-
-static void emit_call(const char *dest, ostream &s)
-{
-  s << CALL << " " << dest << endl;
-}
+///////////////////////////////////////////////////////////////////////////////
 
-static void emit_ret(ostream &s)
+static IRType ir_type(Symbol type)
 {
-  s << RET << endl;
+  if (type == Int)
+    return IR_INT;
+  if (type == Float)
+    return IR_FLOAT;
+  if (type == Bool)
+    return IR_BOOL;
+  if (type == String)
+    return IR_STRING;
+  return IR_VOID;
 }
 
-static void emit_push(const char *reg, ostream &s)
+static Operand value_of(Expr e, IRBuilder &b)
 {
-  s << PUSH << " " << reg << endl;
+  e->code(b);
+  return b.result;
 }
 
-static void emit_pop(const char *reg, ostream &s)
+// The value v of e, converted to Float; a constant is converted here.
+static Operand to_float(Expr e, Operand v, IRBuilder &b)
 {
-  s << POP << " " << reg << endl;
+  if (e->getType() == Float)
+    return v;
+  if (v.kind == Operand::INT)
+    return Operand::fimm(v.ival);
+  return b.unary(OP_I2F, IR_FLOAT, v);
 }
 
-static void emit_leave(ostream &s)
+//
+// Evaluate e1 and e2 into a and c, promoting both to Float if either is,
+// and return the type they are operated on in.
+//
+static IRType code_operands(Expr e1, Expr e2, IRBuilder &b, Operand &a, Operand &c)
 {
-  s << LEAVE << endl;
+  a = value_of(e1, b);
+  c = value_of(e2, b);
+  if (e1->getType() != Float && e2->getType() != Float)
+    return ir_type(e1->getType());
+  a = to_float(e1, a, b);
+  c = to_float(e2, c, b);
+  return IR_FLOAT;
 }
 
-static void emit_position(const char *p, ostream &s)
+static void code_arith(Expr e1, Expr e2, Opcode op, IRBuilder &b)
 {
-  s << p << ":" << endl;
+  Operand a, c;
+  IRType type = code_operands(e1, e2, b, a, c);
+  b.result = b.binary(op, type, a, c);
 }
 
-static void emit_float_to_int(const char *float_mmx, const char *int_reg, ostream &s)
+static void code_compare(Expr e1, Expr e2, Relation rel, IRBuilder &b)
 {
-  s << CVTTSD2SIQ << float_mmx << COMMA << int_reg << endl;
+  Operand a, c;
+  IRType type = code_operands(e1, e2, b, a, c);
+  b.result = b.compare(rel, type, a, c);
 }
 
-static void emit_int_to_float(const char *int_reg, const char *float_mmx, ostream &s)
+static void code_compare_branch(Expr e1, Expr e2, Relation rel, IRBuilder &b,
+                                BasicBlock *if_true, BasicBlock *if_false)
 {
-  s << CVTSI2SDQ << int_reg << COMMA << float_mmx << endl;
+  Operand a, c;
+  IRType type = code_operands(e1, e2, b, a, c);
+  b.branch(rel, type, a, c, if_true, if_false);
 }
 
-static void emit_upmovsd(const char *base_reg, int offset, const char *dest, ostream &s)
+//
+// Evaluate the condition e into a new Bool vreg, 1 or 0.
+//
+static void code_cond_value(Expr e, IRBuilder &b)
 {
-  s << MOVSD << offset << "(" << base_reg << ")" << COMMA << dest << endl;
+  BasicBlock *if_true = b.fn->new_block();
+  BasicBlock *if_false = b.fn->new_block();
+  BasicBlock *join = b.fn->new_block();
+  int value = b.fn->new_vreg(IR_BOOL);
+  e->code_cond(b, if_true, if_false);
+  b.start(if_true);
+  b.move(value, Operand::imm(1));
+  b.jump(join);
+  b.start(if_false);
+  b.move(value, Operand::imm(0));
+  b.start(join);
+  b.result = Operand::vreg(value);
 }
 
-static void emit_rmmovsd(const char *base_reg, int offset, const char *dest, ostream &s)
-{
-  s << MOVSD << base_reg << COMMA << offset << "(" << dest << ")" << endl;
-}
 ///////////////////////////////////////////////////////////////////////////////
 //
 // coding strings, ints, and booleans
@@ -397,8 +229,8 @@ void StringEntry::code_def(ostream &s)
 //
 void StrTable::code_string_table(ostream &s)
 {
-  for (List<StringEntry> *l = tbl; l; l = l->tl())
-    l->hd()->code_def(s);
+  for (int i = first(); more(i); i = next(i))
+    lookup(i)->code_def(s);
 }
 
 // the following 2 functions are useless, please DO NOT care about them
@@ -449,12 +281,19 @@ static void emit_global_bool(Symbol name, ostream &s)
     << BOOLTAG << 0 << endl;
 }
 
-void code_global_data(Decls decls, ostream &str)
+// Is name, of a function, global or string, to be emitted?  Everything is
+// at -O0; otherwise only what main can reach.
+static bool is_used(const std::set<Symbol> &used, Symbol name)
+{
+  return !cgen_optimize || used.count(name);
+}
+
+void code_global_data(Decls decls, const ProgramUses &used, ostream &str)
 {
   int count = 0;
   for (int i = decls->first(); decls->more(i); i = decls->next(i))
   {
-    if (!decls->nth(i)->isCallDecl())
+    if (!decls->nth(i)->isCallDecl() && is_used(used.globals, decls->nth(i)->getName()))
     {
       count++;
       if (count == 1)
@@ -477,28 +316,21 @@ void code_global_data(Decls decls, ostream &str)
   }
 }
 
-void code_calls(Decls decls, ostream &str)
+void code_calls(const std::vector<IRFunction *> &fns, const ProgramUses &used, ostream &str)
 {
-  //string
-  str << SECTION << RODATA << endl;
-  // global variables and string
-  stringtable.code_string_table(str);
+  // strings, in a section the linker merges identical ones across
+  str << SECTION << RODATA_STR << endl;
+  if (!cgen_optimize)
+    stringtable.code_string_table(str);
+  else
+    for (int i = stringtable.first(); stringtable.more(i); i = stringtable.next(i))
+      if (used.strings.count(stringtable.lookup(i)))
+        stringtable.lookup(i)->code_def(str);
   str << TEXT << endl;
-  for (int i = decls->first(); decls->more(i); i = decls->next(i))
-  {
-    if (decls->nth(i)->isCallDecl())
-    {
-      if (decls->nth(i)->getName() == Main)
-      {
-        offset = tadd = 0;
-      }
-      else
-      {
-        offset = tadd = -56;
-      }
-      decls->nth(i)->code(str);
-    }
-  }
+  for (size_t i = 0; i < fns.size(); i++)
+    emit_function(*fns[i], str);
+  emit_float_constants(str);
+  emit_memo_tables(str);
 }
 
 //***************************************************
@@ -521,1072 +353,426 @@ void cgen_helper(Decls decls, ostream &s)
   code(decls, s);
 }
 
+//
+// With -emit-ir, the output is the globals and the IR of every function
+// instead of assembly.
+//
+static void dump_program(Decls decls, const std::vector<IRFunction *> &fns,
+                         const ProgramUses &used, ostream &s)
+{
+  for (int i = decls->first(); decls->more(i); i = decls->next(i))
+  {
+    Decl decl = decls->nth(i);
+    if (!decl->isCallDecl() && is_used(used.globals, decl->getName()))
+      s << "global " << decl->getName() << " : "
+        << ir_type_name(global_types[decl->getName()]) << endl;
+  }
+  s << endl;
+  for (size_t i = 0; i < fns.size(); i++)
+    fns[i]->dump(s);
+}
+
 void code(Decls decls, ostream &s)
 {
-  if (cgen_debug)
-    cout << "Coding global data" << endl;
-  code_global_data(decls, s);
+  for (int i = decls->first(); decls->more(i); i = decls->next(i))
+  {
+    if (!decls->nth(i)->isCallDecl())
+      global_types[decls->nth(i)->getName()] = ir_type(decls->nth(i)->getType());
+  }
 
-  if (cgen_debug)
-    cout << "Coding calls" << endl;
-  code_calls(decls, s);
+  // Every function is lowered before any is emitted, so that under -O
+  // those main never calls and the data only they use can be left out.
+  std::vector<IRFunction *> fns;
+  for (int i = decls->first(); decls->more(i); i = decls->next(i))
+  {
+    if (decls->nth(i)->isCallDecl())
+      fns.push_back(static_cast<CallDecl>(decls->nth(i))->code_ir());
+  }
+  ProgramUses used;
+  if (cgen_optimize)
+    optimize_program(fns, Main, used);
+
+  if (emit_ir)
+    dump_program(decls, fns, used, s);
+  else
+  {
+    if (cgen_debug)
+      cout << "Coding global data" << endl;
+    code_global_data(decls, used, s);
+
+    if (cgen_debug)
+      cout << "Coding calls" << endl;
+    code_calls(fns, used, s);
+  }
+  for (size_t i = 0; i < fns.size(); i++)
+    delete fns[i];
 }
 
 //******************************************************************
 //
-//   Fill in the following methods to produce code for the
-//   appropriate expression.  You may add or remove parameters
-//   as you wish, but if you do, remember to change the parameters
-//   of the declarations in `seal-decl.h', `seal-expr.h' and `seal-stmt.h'
-//   Sample code for constant integers, strings, and booleans are provided.
+//   Lowering to the IR.  Each statement and expression appends its
+//   instructions to the builder's current block, and an expression
+//   leaves its value in the builder's result; see ir.h.
 //
 //*****************************************************************
 
-void CallDecl_class::code(ostream &s)
+//
+// The function lowered to IR, and optimized under -O.  The caller owns it.
+//
+IRFunction *CallDecl_class::code_ir()
 {
-  objectmap.enterscope();
-  
-  s << GLOBAL << name << endl
-    << SYMBOL_TYPE << name << COMMA << FUNCTION << endl
-    << name << ":" << endl;
-  emit_push(RBP, s);
-  emit_mov(RSP, RBP, s);
-  emit_push(RBX, s);
-  emit_push(R10, s);
-  emit_push(R11, s);
-  emit_push(R12, s);
-  emit_push(R13, s);
-  emit_push(R14, s);
-  emit_push(R15, s);
-  int intnumber = 0;
-  int floatnumber = 0;
+  IRFunction *fn = new IRFunction(name, ir_type(returnType));
+  IRBuilder builder(fn);
+  code_body(builder);
+  if (!builder.block->terminated())
+    builder.ret(Operand());
+  fn->compute_cfg();
+  if (cgen_optimize)
+    optimize_ir(*fn);
+  return fn;
+}
+
+void CallDecl_class::code_body(IRBuilder &b)
+{
+  b.vars.enterscope();
   for (int i = paras->first(); paras->more(i); i = paras->next(i))
   {
     Symbol name = paras->nth(i)->getName();
-    Symbol type = paras->nth(i)->getType();
-    
-    if (type == Float)
-    {
-      emit_sub("$8", RSP, s);
-      offset -= 8;
-      objectmap.addid(name, new int(offset));
-      s << MOV << CALL_XMM[floatnumber++] << COMMA << offset << '(' << RBP << ')' << endl;
-    }
-    else if (type == Int || type == Bool)
-    {
-      emit_sub("$8", RSP, s);
-      offset -= 8;
-      objectmap.addid(name, new int(offset));
-      s << MOV << CALL_REGS[intnumber++] << COMMA << offset << '(' << RBP << ')' << endl;
-    }
+    int value = b.fn->new_vreg(ir_type(paras->nth(i)->getType()), name);
+    b.vars.addid(name, ast_arena.make(value));
+    b.fn->params.push_back(value);
   }
-  body->code(s);
-  s << SIZE << name << ", "
-    << ".-" << name << endl;
-  objectmap.exitscope();
+  body->code(b);
+  b.vars.exitscope();
 }
 
-void StmtBlock_class::code(ostream &s)
+void StmtBlock_class::code(IRBuilder &b)
 {
+  b.vars.enterscope();
   for (int i = vars->first(); vars->more(i); i = vars->next(i))
   {
-    offset -= 8;
     Symbol name = vars->nth(i)->getName();
-    objectmap.addid(name, new int(offset));
-    emit_sub("$8", RSP, s);
+    int value = b.fn->new_vreg(ir_type(vars->nth(i)->getType()), name);
+    b.vars.addid(name, ast_arena.make(value));
   }
   for (int i = stmts->first(); stmts->more(i); i = stmts->next(i))
   {
-    stmts->nth(i)->code(s);
+    stmts->nth(i)->code(b);
   }
+  b.vars.exitscope();
 }
 
-void IfStmt_class::code(ostream &s)
-{
-  this->condition->code(s);
-  emit_mrmov(RBP, tadd, RAX, s);
-  emit_test(RAX, RAX, s);
-  int else_pos = num_label++;
-  int then_pos = num_label++;
-  s << JZ << " " << POSITION << else_pos << endl;
-  thenexpr->code(s);
-
-  s << JMP << " " << POSITION << then_pos << endl;
-  s << POSITION << else_pos << ":" << endl;
-  elseexpr->code(s);
-  s << POSITION << then_pos << ":" << endl;
-}
-
-void WhileStmt_class::code(ostream &s)
-{
-  int pos1 = num_label++;
-  int pos2 = num_label++;
-  continuepos = pos1;
-  breakpos = pos2;
-  s << POSITION << pos1 << ":" << endl;
-  condition->code(s);
-  emit_mrmov(RBP, tadd, RAX, s);
-  emit_test(RAX, RAX, s);
-  s << JZ << ' ' << POSITION << pos2 << endl;
-  body->code(s);
-  s << JMP << ' ' << POSITION << pos1 << endl;
-  s << POSITION << pos2 << ":" << endl;
-}
-
-void ForStmt_class::code(ostream &s)
-{
-  int pos1 = num_label++;
-  int pos3 = num_label++;
-  int pos2 = num_label++;
-  continuepos = pos3;
-  breakpos = pos2;
-  initexpr->code(s);
-  s << POSITION << pos1 << ":" << endl;
-  condition->code(s);
-  emit_mrmov(RBP, tadd, RAX, s);
-  emit_test(RAX, RAX, s);
-  s << JZ << " " << POSITION << pos2 << endl;
-  body->code(s);
-  s << POSITION << pos3 << ":" << endl;
-  loopact->code(s);
-  s << JMP << " " << POSITION << pos1 << endl;
-  s << POSITION << pos2 << ":" << endl;
-}
-
-void ReturnStmt_class::code(ostream &s)
-{
-  value->code(s);
-  if (value->getType()->get_string() == Float->get_string())
-  {
-    s << MOVAPS << tadd << "(" << RBP << "), " << XMM0 << endl;
-  }
-  else if (value->getType()->get_string() != Void->get_string())
-  {
-    emit_mrmov(RBP, tadd, RAX, s);
-  }
-  emit_pop(R15, s);
-  emit_pop(R14, s);
-  emit_pop(R13, s);
-  emit_pop(R12, s);
-  emit_pop(R11, s);
-  emit_pop(R10, s);
-  emit_pop(RBX, s);
-
-  s << LEAVE << endl
-    << RET << endl;
+void IfStmt_class::code(IRBuilder &b)
+{
+  BasicBlock *then_block = b.fn->new_block();
+  BasicBlock *else_block = b.fn->new_block();
+  BasicBlock *join = b.fn->new_block();
+  condition->code_cond(b, then_block, else_block);
+  b.start(then_block);
+  thenexpr->code(b);
+  b.jump(join);
+  b.start(else_block);
+  elseexpr->code(b);
+  b.start(join);
 }
 
-void ContinueStmt_class::code(ostream &s)
+void WhileStmt_class::code(IRBuilder &b)
 {
-  s << JMP << " " << POSITION << continuepos << endl;
+  BasicBlock *header = b.fn->new_block();
+  BasicBlock *body_block = b.fn->new_block();
+  BasicBlock *exit = b.fn->new_block();
+  BasicBlock *outer_continue = b.continue_target;
+  BasicBlock *outer_break = b.break_target;
+  b.continue_target = header;
+  b.break_target = exit;
+  b.start(header);
+  condition->code_cond(b, body_block, exit);
+  b.start(body_block);
+  body->code(b);
+  b.jump(header);
+  b.start(exit);
+  b.continue_target = outer_continue;
+  b.break_target = outer_break;
 }
 
-void BreakStmt_class::code(ostream &s)
+void ForStmt_class::code(IRBuilder &b)
 {
-  s << JMP << " " << POSITION << breakpos << endl;
+  BasicBlock *header = b.fn->new_block();
+  BasicBlock *body_block = b.fn->new_block();
+  BasicBlock *step = b.fn->new_block();
+  BasicBlock *exit = b.fn->new_block();
+  BasicBlock *outer_continue = b.continue_target;
+  BasicBlock *outer_break = b.break_target;
+  b.continue_target = step;
+  b.break_target = exit;
+  initexpr->code(b);
+  b.start(header);
+  if (!condition->is_empty_Expr())
+    condition->code_cond(b, body_block, exit);
+  b.start(body_block);
+  body->code(b);
+  b.start(step);
+  loopact->code(b);
+  b.jump(header);
+  b.start(exit);
+  b.continue_target = outer_continue;
+  b.break_target = outer_break;
 }
 
-void Call_class::code(ostream &s)
+void ReturnStmt_class::code(IRBuilder &b)
 {
-  int intnumber = 0;
-  int floatnumber = 0;
-  int addr[actuals->len()];
-  int nn = 0;
-  for (int i = actuals->first(); actuals->more(i); i = actuals->next(i))
+  if (value->is_empty_Expr())
   {
-    if (actuals->nth(i)->getType()->get_string() == Int->get_string() || actuals->nth(i)->getType()->get_string() == Bool->get_string() || actuals->nth(i)->getType()->get_string() == String->get_string())
-    {
-      actuals->nth(i)->code(s);
-      addr[i] = tadd;
-    }
-    if (actuals->nth(i)->getType()->get_string() == Float->get_string())
-    {
-      nn++;
-      actuals->nth(i)->code(s);
-      addr[i] = tadd;
-    }
-  }
-  for (int i = actuals->first(); actuals->more(i); i = actuals->next(i))
-  {
-    if (actuals->nth(i)->getType()->get_string() == Int->get_string() || actuals->nth(i)->getType()->get_string() == Bool->get_string() || actuals->nth(i)->getType()->get_string() == String->get_string())
-    {
-      s << MOV << addr[i] << "(" << RBP << ")" << COMMA << CALL_REGS[intnumber++] << endl;
-    }
-    else if (actuals->nth(i)->getType()->get_string() == Float->get_string())
-    {
-      s << MOVSD << addr[i] << "(" << RBP << ")" << COMMA << CALL_XMM[floatnumber++] << endl;
-    }
-  }
-  if (name == print)
-  {
-    emit_sub("$8", RSP, s);
-    offset -= 8;
-    s << MOVL << "$" << nn << COMMA << EAX << endl;
-    emit_call("printf", s);
-  }
-  else if (type->get_string() == Int->get_string() || type->get_string() == Bool->get_string() || type->get_string() == String->get_string())
-  {
-    emit_call(name->get_string(), s);
-    emit_sub("$8", RSP, s);
-    offset -= 8;
-    tadd = offset;
-    emit_rmmov(RAX, offset, RBP, s);
-  }
-  else if (type->get_string() == Float->get_string())
-  {
-    emit_call(name->get_string(), s);
-    emit_sub("$8", RSP, s);
-    offset -= 8;
-    tadd = offset;
-    emit_rmmovsd(XMM0, offset, RBP, s);
+    b.ret(Operand());
+    return;
   }
+  Operand result = value_of(value, b);
+  if (b.fn->ret_type == IR_FLOAT)
+    result = to_float(value, result, b);
+  b.ret(result);
 }
 
-void Actual_class::code(ostream &s)
+void ContinueStmt_class::code(IRBuilder &b)
 {
-  expr->code(s);
+  b.jump(b.continue_target);
 }
 
-void Assign_class::code(ostream &s)
+void BreakStmt_class::code(IRBuilder &b)
 {
-  value->code(s);
-  emit_mrmov(RBP, tadd, RAX, s);
-  objectmap.enterscope();
-  tadd = *objectmap.lookup(lvalue);
-  objectmap.exitscope();
-  emit_rmmov(RAX, tadd, RBP, s);
+  b.jump(b.break_target);
 }
 
-void Add_class::code(ostream &s)
+void Expr_class::code_cond(IRBuilder &b, BasicBlock *if_true, BasicBlock *if_false)
 {
-  e1->code(s);
-  int varaddress1 = tadd;
-  e2->code(s);
-  int varaddress2 = tadd;
-  emit_sub("$8", RSP, s);
-  offset -= 8;
-  tadd = offset;
-  if (e1->getType()->get_string() == Int->get_string() && e2->getType()->get_string() == Int->get_string())
-  {
-    emit_mrmov(RBP, varaddress1, RBX, s);
-    emit_mrmov(RBP, varaddress2, R10, s);
-
-    emit_add(R10, RBX, s);
-    emit_rmmov(RBX, offset, RBP, s);
-  }
-  else if (e1->getType()->get_string() == Float->get_string() && e2->getType()->get_string() == Float->get_string())
-  {
-    emit_upmovsd(RBP, varaddress1, XMM4, s);
-    emit_upmovsd(RBP, varaddress2, XMM5, s);
-    emit_addsd(XMM5, XMM4, s);
-    emit_rmmovsd(XMM4, offset, RBP, s);
-  }
-  else if (e1->getType()->get_string() == Int->get_string() && e2->getType()->get_string() == Float->get_string())
-  {
-    emit_mrmov(RBP, varaddress1, RBX, s);
-    emit_upmovsd(RBP, varaddress2, XMM5, s);
-    emit_int_to_float(RBX, XMM4, s);
-    emit_addsd(XMM5, XMM4, s);
-    emit_rmmovsd(XMM4, offset, RBP, s);
-  }
-  else if (e1->getType()->get_string() == Float->get_string() && e2->getType()->get_string() == Int->get_string())
-  {
-    emit_upmovsd(RBP, varaddress1, XMM4, s);
-    emit_mrmov(RBP, varaddress2, RBX, s);
-    emit_int_to_float(RBX, XMM5, s);
-    emit_addsd(XMM5, XMM4, s);
-    emit_rmmovsd(XMM4, offset, RBP, s);
-  }
+  Operand value = value_of(this, b);
+  b.branch(REL_NE, ir_type(type), value, Operand::imm(0), if_true, if_false);
 }
 
-void Minus_class::code(ostream &s)
+void Call_class::code(IRBuilder &b)
 {
-  e1->code(s);
-  int varaddress1 = tadd;
-
-  e2->code(s);
-  int varaddress2 = tadd;
-
-  emit_sub("$8", RSP, s);
-
-  offset -= 8;
-  tadd = offset;
-  if (e1->getType()->get_string() == Int->get_string() && e2->getType()->get_string() == Int->get_string())
-  {
-    emit_mrmov(RBP, varaddress1, RBX, s);
-    emit_mrmov(RBP, varaddress2, R10, s);
-    emit_sub(R10, RBX, s);
-    emit_rmmov(RBX, offset, RBP, s);
-  }
-  else if (e1->getType()->get_string() == Float->get_string() && e2->getType()->get_string() == Float->get_string())
-  {
-    emit_upmovsd(RBP, varaddress1, XMM4, s);
-    emit_upmovsd(RBP, varaddress2, XMM5, s);
-    emit_subsd(XMM5, XMM4, s);
-    emit_rmmovsd(XMM4, offset, RBP, s);
-  }
-  else if (e1->getType()->get_string() == Int->get_string() && e2->getType()->get_string() == Float->get_string())
-  {
-    emit_mrmov(RBP, varaddress1, RBX, s);
-    emit_upmovsd(RBP, varaddress2, XMM5, s);
-    emit_int_to_float(RBX, XMM4, s);
-    emit_subsd(XMM5, XMM4, s);
-    emit_rmmovsd(XMM4, offset, RBP, s);
-  }
-  else if (e1->getType()->get_string() == Float->get_string() && e2->getType()->get_string() == Int->get_string())
+  std::vector<Operand> args;
+  for (int i = actuals->first(); actuals->more(i); i = actuals->next(i))
   {
-    emit_upmovsd(RBP, varaddress1, XMM4, s);
-    emit_mrmov(RBP, varaddress2, RBX, s);
-    emit_int_to_float(RBX, XMM5, s);
-    emit_subsd(XMM5, XMM4, s);
-    emit_rmmovsd(XMM4, offset, RBP, s);
+    args.push_back(value_of(actuals->nth(i), b));
   }
+  b.result = b.call(name, name == print ? IR_VOID : ir_type(type), args);
 }
 
-void Multi_class::code(ostream &s)
+void Actual_class::code(IRBuilder &b)
 {
-  e1->code(s);
-  int varaddress1 = tadd;
-  e2->code(s);
-  int varaddress2 = tadd;
-  emit_sub("$8", RSP, s);
-  offset -= 8;
-  tadd = offset;
-  if (e1->getType()->get_string() == Int->get_string() && e2->getType()->get_string() == Int->get_string())
-  {
-    emit_mrmov(RBP, varaddress1, RBX, s);
-    emit_mrmov(RBP, varaddress2, R10, s);
-    emit_mul(R10, RBX, s);
-    emit_rmmov(RBX, offset, RBP, s);
-  }
-  else if (e1->getType()->get_string() == Int->get_string() && e2->getType()->get_string() == Float->get_string())
-  {
-    emit_mrmov(RBP, varaddress1, RBX, s);
-    emit_upmovsd(RBP, varaddress2, XMM5, s);
-    emit_int_to_float(RBX, XMM4, s);
-    emit_mulsd(XMM5, XMM4, s);
-    emit_rmmovsd(XMM4, offset, RBP, s);
-  }
-  else if (e1->getType()->get_string() == Float->get_string() && e2->getType()->get_string() == Float->get_string())
-  {
-    emit_upmovsd(RBP, varaddress1, XMM4, s);
-    emit_upmovsd(RBP, varaddress2, XMM5, s);
-    emit_mulsd(XMM5, XMM4, s);
-    emit_rmmovsd(XMM4, offset, RBP, s);
-  }
-  
-  else if (e1->getType()->get_string() == Float->get_string() && e2->getType()->get_string() == Int->get_string())
-  {
-    emit_upmovsd(RBP, varaddress1, XMM4, s);
-    emit_mrmov(RBP, varaddress2, RBX, s);
-    emit_int_to_float(RBX, XMM5, s);
-    emit_mulsd(XMM5, XMM4, s);
-    emit_rmmovsd(XMM4, offset, RBP, s);
-  }
+  expr->code(b);
 }
 
-void Divide_class::code(ostream &s)
+void Assign_class::code(IRBuilder &b)
 {
-  e1->code(s);
-  int varaddress1 = tadd;
-  e2->code(s);
-  int varaddress2 = tadd;
-  emit_sub("$8", RSP, s);
-  offset -= 8;
-  tadd = offset;
-  if (e1->getType()->get_string() == Int->get_string() && e2->getType()->get_string() == Int->get_string())
-  {
-    emit_mrmov(RBP, varaddress1, RAX, s);
-    emit_cqto(s);
-    emit_mrmov(RBP, varaddress2, RAX, s);
-    emit_div(RBX, s);
-    emit_rmmov(RAX, offset, RBP, s);
-  }
-  else if (e1->getType()->get_string() == Float->get_string() && e2->getType()->get_string() == Float->get_string())
+  Operand source = value_of(value, b);
+  int *var = b.vars.lookup(lvalue);
+  IRType type = var != NULL ? b.fn->vreg_type[*var] : global_types[lvalue];
+  if (type == IR_FLOAT)
+    source = to_float(value, source, b);
+  if (var == NULL)
   {
-    emit_upmovsd(RBP, varaddress1, XMM4, s);
-    emit_upmovsd(RBP, varaddress2, XMM5, s);
-    emit_divsd(XMM5, XMM4, s);
-    emit_rmmovsd(XMM4, offset, RBP, s);
-  }
-  else if (e1->getType()->get_string() == Int->get_string() && e2->getType()->get_string() == Float->get_string())
-  {
-    emit_mrmov(RBP, varaddress1, RBX, s);
-    emit_upmovsd(RBP, varaddress2, XMM5, s);
-    emit_int_to_float(RBX, XMM4, s);
-    emit_divsd(XMM5, XMM4, s);
-    emit_rmmovsd(XMM4, offset, RBP, s);
-  }
-  else if (e1->getType()->get_string() == Float->get_string() && e2->getType()->get_string() == Int->get_string())
-  {
-    emit_upmovsd(RBP, varaddress1, XMM4, s);
-    emit_mrmov(RBP, varaddress2, RBX, s);
-    emit_int_to_float(RBX, XMM5, s);
-    emit_divsd(XMM5, XMM4, s);
-    emit_rmmovsd(XMM4, offset, RBP, s);
-  }
-}
-// 只按照整数进行处理
-void Mod_class::code(ostream &s)
-{
-  e1->code(s);
-  int varaddress1 = tadd;
-  e2->code(s);
-  int varaddress2 = tadd;
-  emit_sub("$8", RSP, s);
-  offset -= 8;
-  tadd = offset;
-  emit_mrmov(RBP, varaddress1, RAX, s);
-  emit_cqto(s);
-  emit_mrmov(RBP, varaddress2, RBX, s);
-  emit_div(RBX, s);
-  emit_rmmov(RDX, offset, RBP, s);
-}
-
-void Neg_class::code(ostream &s)
-{
-  e1->code(s);
-  int varaddress1 = tadd;
-  emit_sub("$8", RSP, s);
-  offset -= 8;
-  tadd = offset;
-  if (e1->getType()->get_string() == Int->get_string())
-  {
-    emit_mrmov(RBP, varaddress1, RAX, s);
-    emit_neg(RAX, s);
-    emit_rmmov(RAX, offset, RBP, s);
-  }
-  else
-  {
-    emit_sub("$8", RSP, s);
-    emit_mov("$0x8000000000000000", RAX, s);
-    emit_mrmov(RBP, offset, RDX, s);
-    emit_xor(RAX, RDX, s);
-    emit_rmmov(RDX, offset, RBP, s);
+    b.store(lvalue, source);
+    b.result = source;
+    return;
   }
+  b.move(*var, source);
+  b.result = Operand::vreg(*var);
 }
 
-void Lt_class::code(ostream &s)
+void Add_class::code(IRBuilder &b)
 {
-  e1->code(s);
-  int varaddress1 = tadd;
-  e2->code(s);
-  int varaddress2 = tadd;
-
-  emit_sub("$8", RSP, s);
-  offset -= 8;
-  tadd = offset;
-  if (e1->getType()->get_string() == Int->get_string() && e2->getType()->get_string() == Int->get_string())
-  {
-    emit_mrmov(RBP, varaddress1, RAX, s);
-    emit_mrmov(RBP, varaddress2, RDX, s);
-    emit_cmp(RDX, RAX, s);
-    int pos1 = num_label++;
-    int pos2 = num_label++;
-    s << JL << " " << POSITION << pos1 << endl;
-    emit_mov("$0", RAX, s);
-    s << JMP << " " << POSITION << pos2 << endl;
-    s << POSITION << pos1 << ":" << endl;
-    emit_mov("$1", RAX, s);
-    s << POSITION << pos2 << ":" << endl;
-    emit_rmmov(RAX, offset, RBP, s);
-  }
-  else if (e1->getType()->get_string() == Float->get_string() && e2->getType()->get_string() == Int->get_string())
-  {
-    emit_upmovsd(RBP, varaddress1, XMM1, s);
-    emit_mrmov(RBP, varaddress2, RAX, s);
-    emit_int_to_float(RAX, XMM0, s);
-    emit_ucompisd(XMM0, XMM1, s);
-    int pos1 = num_label++;
-    int pos2 = num_label++;
-    s << JB << " " << POSITION << pos1 << endl;
-    emit_mov("$0", RAX, s);
-    s << JMP << " " << POSITION << pos2 << endl;
-    s << POSITION << pos1 << ":" << endl;
-    emit_mov("$1", RAX, s);
-    s << POSITION << pos2 << ":" << endl;
-    emit_rmmov(RAX, offset, RBP, s);
-  }
-  else if (e1->getType()->get_string() == Int->get_string() && e2->getType()->get_string() == Float->get_string())
-  {
-    emit_mrmov(RBP, varaddress1, RAX, s);
-    emit_int_to_float(RAX, XMM0, s);
-    emit_upmovsd(RBP, varaddress2, XMM1, s);
-    emit_ucompisd(XMM0, XMM1, s);
-    int pos1 = num_label++;
-    int pos2 = num_label++;
-    s << JB << " " << POSITION << pos1 << endl;
-    emit_mov("$0", RAX, s);
-    s << JMP << " " << POSITION << pos2 << endl;
-    s << POSITION << pos1 << ":" << endl;
-    emit_mov("$1", RAX, s);
-    s << POSITION << pos2 << ":" << endl;
-    emit_rmmov(RAX, 0, RBP, s);
-  }
-  else if (e1->getType()->get_string() == Float->get_string() && e2->getType()->get_string() == Float->get_string())
-  {
-    emit_upmovsd(RBP, varaddress1, XMM0, s);
-    emit_upmovsd(RBP, varaddress2, XMM1, s);
-    emit_ucompisd(XMM0, XMM1, s);
-    int pos1 = num_label++;
-    int pos2 = num_label++;
-    s << JB << " " << POSITION << pos1 << endl;
-    emit_mov("$0", RAX, s);
-    s << JMP << " " << POSITION << pos2 << endl;
-    s << POSITION << pos1 << ":" << endl;
-    emit_mov("$1", RAX, s);
-    s << POSITION << pos2 << ":" << endl;
-    emit_rmmov(RAX, offset, RBP, s);
-  }
+  code_arith(e1, e2, OP_ADD, b);
 }
 
-void Le_class::code(ostream &s)
+void Minus_class::code(IRBuilder &b)
 {
-  e1->code(s);
-  int varaddress1 = tadd;
-  e2->code(s);
-  int varaddress2 = tadd;
-
-  emit_sub("$8", RSP, s);
-  offset -= 8;
-  tadd = offset;
-  if (e1->getType()->get_string() == Int->get_string() && e2->getType()->get_string() == Int->get_string())
-  {
-    emit_mrmov(RBP, varaddress1, RAX, s);
-    emit_mrmov(RBP, varaddress2, RDX, s);
-    emit_cmp(RDX, RAX, s);
-    int pos1 = num_label++;
-    int pos2 = num_label++;
-    s << JLE << " " << POSITION << pos1 << endl;
-    emit_mov("$0", RAX, s);
-    s << JMP << " " << POSITION << pos2 << endl;
-    s << POSITION << pos1 << ":" << endl;
-    emit_mov("$1", RAX, s);
-    s << POSITION << pos2 << ":" << endl;
-    emit_rmmov(RAX, offset, RBP, s);
-  }
-  else if (e1->getType()->get_string() == Float->get_string() && e2->getType()->get_string() == Int->get_string())
-  {
-    emit_upmovsd(RBP, varaddress1, XMM1, s);
-    emit_mrmov(RBP, varaddress2, RAX, s);
-    emit_int_to_float(RAX, XMM0, s);
-    emit_ucompisd(XMM0, XMM1, s);
-    int pos1 = num_label++;
-    int pos2 = num_label++;
-    s << JBE << " " << POSITION << pos1 << endl;
-    emit_mov("$0", RAX, s);
-    s << JMP << " " << POSITION << pos2 << endl;
-    s << POSITION << pos1 << ":" << endl;
-    emit_mov("$1", RAX, s);
-    s << POSITION << pos2 << ":" << endl;
-    emit_rmmov(RAX, offset, RBP, s);
-  }
-  else if (e1->getType()->get_string() == Int->get_string() && e2->getType()->get_string() == Float->get_string())
-  {
-    emit_mrmov(RBP, varaddress1, RAX, s);
-    emit_int_to_float(RAX, XMM0, s);
-    emit_upmovsd(RBP, varaddress2, XMM1, s);
-    emit_ucompisd(XMM0, XMM1, s);
-    int pos1 = num_label++;
-    int pos2 = num_label++;
-    s << JBE << " " << POSITION << pos1 << endl;
-    emit_mov("$0", RAX, s);
-    s << JMP << " " << POSITION << pos2 << endl;
-    s << POSITION << pos1 << ":" << endl;
-    emit_mov("$1", RAX, s);
-    s << POSITION << pos2 << ":" << endl;
-    emit_rmmov(RAX, 0, RBP, s);
-  }
-  else if (e1->getType()->get_string() == Float->get_string() && e2->getType()->get_string() == Float->get_string())
-  {
-    emit_upmovsd(RBP, varaddress1, XMM0, s);
-    emit_upmovsd(RBP, varaddress2, XMM1, s);
-    emit_ucompisd(XMM0, XMM1, s);
-    int pos1 = num_label++;
-    int pos2 = num_label++;
-    s << JBE << " " << POSITION << pos1 << endl;
-    emit_mov("$0", RAX, s);
-    s << JMP << " " << POSITION << pos2 << endl;
-    s << POSITION << pos1 << ":" << endl;
-    emit_mov("$1", RAX, s);
-    s << POSITION << pos2 << ":" << endl;
-    emit_rmmov(RAX, offset, RBP, s);
-  }
+  code_arith(e1, e2, OP_SUB, b);
 }
 
-void Equ_class::code(ostream &s)
+void Multi_class::code(IRBuilder &b)
 {
-  e1->code(s);
-  int varaddress1 = tadd;
-  e2->code(s);
-  int varaddress2 = tadd;
-
-  emit_sub("$8", RSP, s);
-  offset -= 8;
-  tadd = offset;
-  if (e1->getType()->get_string() == Int->get_string() && e2->getType()->get_string() == Int->get_string())
-  {
-    emit_mrmov(RBP, varaddress1, RAX, s);
-    emit_mrmov(RBP, varaddress2, RDX, s);
-    emit_cmp(RDX, RAX, s);
-    int pos1 = num_label++;
-    int pos2 = num_label++;
-    s << JE << " " << POSITION << pos1 << endl;
-    emit_mov("$0", RAX, s);
-    s << JMP << " " << POSITION << pos2 << endl;
-    s << POSITION << pos1 << ":" << endl;
-    emit_mov("$1", RAX, s);
-    s << POSITION << pos2 << ":" << endl;
-    emit_rmmov(RAX, offset, RBP, s);
-  }
-  else if (e1->getType()->get_string() == Float->get_string() && e2->getType()->get_string() == Int->get_string())
-  {
-    emit_upmovsd(RBP, varaddress1, XMM1, s);
-    emit_mrmov(RBP, varaddress2, RAX, s);
-    emit_int_to_float(RAX, XMM0, s);
-    emit_ucompisd(XMM0, XMM1, s);
-    int pos1 = num_label++;
-    int pos2 = num_label++;
-    s << JE << " " << POSITION << pos1 << endl;
-    emit_mov("$0", RAX, s);
-    s << JMP << " " << POSITION << pos2 << endl;
-    s << POSITION << pos1 << ":" << endl;
-    emit_mov("$1", RAX, s);
-    s << POSITION << pos2 << ":" << endl;
-    emit_rmmov(RAX, offset, RBP, s);
-  }
-  else if (e1->getType()->get_string() == Int->get_string() && e2->getType()->get_string() == Float->get_string())
-  {
-    emit_mrmov(RBP, varaddress1, RAX, s);
-    emit_int_to_float(RAX, XMM0, s);
-    emit_upmovsd(RBP, varaddress2, XMM1, s);
-    emit_ucompisd(XMM0, XMM1, s);
-    int pos1 = num_label++;
-    int pos2 = num_label++;
-    s << JE << " " << POSITION << pos1 << endl;
-    emit_mov("$0", RAX, s);
-    s << JMP << " " << POSITION << pos2 << endl;
-    s << POSITION << pos1 << ":" << endl;
-    emit_mov("$1", RAX, s);
-    s << POSITION << pos2 << ":" << endl;
-    emit_rmmov(RAX, 0, RBP, s);
-  }
-  else if (e1->getType()->get_string() == Float->get_string() && e2->getType()->get_string() == Float->get_string())
-  {
-    emit_upmovsd(RBP, varaddress1, XMM0, s);
-    emit_upmovsd(RBP, varaddress2, XMM1, s);
-    emit_ucompisd(XMM0, XMM1, s);
-    int pos1 = num_label++;
-    int pos2 = num_label++;
-    s << JE << " " << POSITION << pos1 << endl;
-    emit_mov("$0", RAX, s);
-    s << JMP << " " << POSITION << pos2 << endl;
-    s << POSITION << pos1 << ":" << endl;
-    emit_mov("$1", RAX, s);
-    s << POSITION << pos2 << ":" << endl;
-    emit_rmmov(RAX, offset, RBP, s);
-  }
+  code_arith(e1, e2, OP_MUL, b);
 }
 
-void Neq_class::code(ostream &s)
+void Divide_class::code(IRBuilder &b)
 {
-  e1->code(s);
-  int varaddress1 = tadd;
-  e2->code(s);
-  int varaddress2 = tadd;
-
-  emit_sub("$8", RSP, s);
-  offset -= 8;
-  tadd = offset;
-  if (e1->getType()->get_string() == Int->get_string() && e2->getType()->get_string() == Int->get_string())
-  {
-    emit_mrmov(RBP, varaddress1, RAX, s);
-    emit_mrmov(RBP, varaddress2, RDX, s);
-    emit_cmp(RDX, RAX, s);
-    int pos1 = num_label++;
-    int pos2 = num_label++;
-    s << JNE << " " << POSITION << pos1 << endl;
-    emit_mov("$0", RAX, s);
-    s << JMP << " " << POSITION << pos2 << endl;
-    s << POSITION << pos1 << ":" << endl;
-    emit_mov("$1", RAX, s);
-    s << POSITION << pos2 << ":" << endl;
-    emit_rmmov(RAX, offset, RBP, s);
-  }
-  else if (e1->getType()->get_string() == Float->get_string() && e2->getType()->get_string() == Int->get_string())
-  {
-    emit_upmovsd(RBP, varaddress1, XMM1, s);
-    emit_mrmov(RBP, varaddress2, RAX, s);
-    emit_int_to_float(RAX, XMM0, s);
-    emit_ucompisd(XMM0, XMM1, s);
-    int pos1 = num_label++;
-    int pos2 = num_label++;
-    s << JNE << " " << POSITION << pos1 << endl;
-    emit_mov("$0", RAX, s);
-    s << JMP << " " << POSITION << pos2 << endl;
-    s << POSITION << pos1 << ":" << endl;
-    emit_mov("$1", RAX, s);
-    s << POSITION << pos2 << ":" << endl;
-    emit_rmmov(RAX, offset, RBP, s);
-  }
-  else if (e1->getType()->get_string() == Int->get_string() && e2->getType()->get_string() == Float->get_string())
-  {
-    emit_mrmov(RBP, varaddress1, RAX, s);
-    emit_int_to_float(RAX, XMM0, s);
-    emit_upmovsd(RBP, varaddress2, XMM1, s);
-    emit_ucompisd(XMM0, XMM1, s);
-    int pos1 = num_label++;
-    int pos2 = num_label++;
-    s << JNE << " " << POSITION << pos1 << endl;
-    emit_mov("$0", RAX, s);
-    s << JMP << " " << POSITION << pos2 << endl;
-    s << POSITION << pos1 << ":" << endl;
-    emit_mov("$1", RAX, s);
-    s << POSITION << pos2 << ":" << endl;
-    emit_rmmov(RAX, 0, RBP, s);
-  }
-  else if (e1->getType()->get_string() == Float->get_string() && e2->getType()->get_string() == Float->get_string())
-  {
-    emit_upmovsd(RBP, varaddress1, XMM0, s);
-    emit_upmovsd(RBP, varaddress2, XMM1, s);
-    emit_ucompisd(XMM0, XMM1, s);
-    int pos1 = num_label++;
-    int pos2 = num_label++;
-    s << JNE << " " << POSITION << pos1 << endl;
-    emit_mov("$0", RAX, s);
-    s << JMP << " " << POSITION << pos2 << endl;
-    s << POSITION << pos1 << ":" << endl;
-    emit_mov("$1", RAX, s);
-    s << POSITION << pos2 << ":" << endl;
-    emit_rmmov(RAX, offset, RBP, s);
-  }
+  code_arith(e1, e2, OP_DIV, b);
 }
-
-void Ge_class::code(ostream &s)
+// 只按照整数进行处理
+void Mod_class::code(IRBuilder &b)
 {
-  e1->code(s);
-  int varaddress1 = tadd;
-  e2->code(s);
-  int varaddress2 = tadd;
-
-  emit_sub("$8", RSP, s);
-  offset -= 8;
-  tadd = offset;
-  if (e1->getType()->get_string() == Int->get_string() && e2->getType()->get_string() == Int->get_string())
-  {
-    emit_mrmov(RBP, varaddress1, RAX, s);
-    emit_mrmov(RBP, varaddress2, RDX, s);
-    emit_cmp(RDX, RAX, s);
-    int pos1 = num_label++;
-    int pos2 = num_label++;
-    s << JGE << " " << POSITION << pos1 << endl;
-    emit_mov("$0", RAX, s);
-    s << JMP << " " << POSITION << pos2 << endl;
-    s << POSITION << pos1 << ":" << endl;
-    emit_mov("$1", RAX, s);
-    s << POSITION << pos2 << ":" << endl;
-    emit_rmmov(RAX, offset, RBP, s);
-  }
-  else if (e1->getType()->get_string() == Float->get_string() && e2->getType()->get_string() == Int->get_string())
-  {
-    emit_upmovsd(RBP, varaddress1, XMM1, s);
-    emit_mrmov(RBP, varaddress2, RAX, s);
-    emit_int_to_float(RAX, XMM0, s);
-    emit_ucompisd(XMM0, XMM1, s);
-    int pos1 = num_label++;
-    int pos2 = num_label++;
-    s << JAE << " " << POSITION << pos1 << endl;
-    emit_mov("$0", RAX, s);
-    s << JMP << " " << POSITION << pos2 << endl;
-    s << POSITION << pos1 << ":" << endl;
-    emit_mov("$1", RAX, s);
-    s << POSITION << pos2 << ":" << endl;
-    emit_rmmov(RAX, offset, RBP, s);
-  }
-  else if (e1->getType()->get_string() == Int->get_string() && e2->getType()->get_string() == Float->get_string())
-  {
-    emit_mrmov(RBP, varaddress1, RAX, s);
-    emit_int_to_float(RAX, XMM0, s);
-    emit_upmovsd(RBP, varaddress2, XMM1, s);
-    emit_ucompisd(XMM0, XMM1, s);
-    int pos1 = num_label++;
-    int pos2 = num_label++;
-    s << JAE << " " << POSITION << pos1 << endl;
-    emit_mov("$0", RAX, s);
-    s << JMP << " " << POSITION << pos2 << endl;
-    s << POSITION << pos1 << ":" << endl;
-    emit_mov("$1", RAX, s);
-    s << POSITION << pos2 << ":" << endl;
-    emit_rmmov(RAX, 0, RBP, s);
-  }
-  else if (e1->getType()->get_string() == Float->get_string() && e2->getType()->get_string() == Float->get_string())
-  {
-    emit_upmovsd(RBP, varaddress1, XMM0, s);
-    emit_upmovsd(RBP, varaddress2, XMM1, s);
-    emit_ucompisd(XMM0, XMM1, s);
-    int pos1 = num_label++;
-    int pos2 = num_label++;
-    s << JAE << " " << POSITION << pos1 << endl;
-    emit_mov("$0", RAX, s);
-    s << JMP << " " << POSITION << pos2 << endl;
-    s << POSITION << pos1 << ":" << endl;
-    emit_mov("$1", RAX, s);
-    s << POSITION << pos2 << ":" << endl;
-    emit_rmmov(RAX, offset, RBP, s);
-  }
+  code_arith(e1, e2, OP_MOD, b);
 }
 
-void Gt_class::code(ostream &s)
+void Neg_class::code(IRBuilder &b)
 {
-  e1->code(s);
-  int varaddress1 = tadd;
-  e2->code(s);
-  int varaddress2 = tadd;
-
-  emit_sub("$8", RSP, s);
-  offset -= 8;
-  tadd = offset;
-  if (e1->getType()->get_string() == Int->get_string() && e2->getType()->get_string() == Int->get_string())
-  {
-    emit_mrmov(RBP, varaddress1, RAX, s);
-    emit_mrmov(RBP, varaddress2, RDX, s);
-    emit_cmp(RDX, RAX, s);
-    int pos1 = num_label++;
-    int pos2 = num_label++;
-    s << JG << " " << POSITION << pos1 << endl;
-    emit_mov("$0", RAX, s);
-    s << JMP << " " << POSITION << pos2 << endl;
-    s << POSITION << pos1 << ":" << endl;
-    emit_mov("$1", RAX, s);
-    s << POSITION << pos2 << ":" << endl;
-    emit_rmmov(RAX, offset, RBP, s);
-  }
-  else if (e1->getType()->get_string() == Float->get_string() && e2->getType()->get_string() == Int->get_string())
-  {
-    emit_upmovsd(RBP, varaddress1, XMM1, s);
-    emit_mrmov(RBP, varaddress2, RAX, s);
-    emit_int_to_float(RAX, XMM0, s);
-    emit_ucompisd(XMM0, XMM1, s);
-    int pos1 = num_label++;
-    int pos2 = num_label++;
-    s << JA << " " << POSITION << pos1 << endl;
-    emit_mov("$0", RAX, s);
-    s << JMP << " " << POSITION << pos2 << endl;
-    s << POSITION << pos1 << ":" << endl;
-    emit_mov("$1", RAX, s);
-    s << POSITION << pos2 << ":" << endl;
-    emit_rmmov(RAX, offset, RBP, s);
-  }
-  else if (e1->getType()->get_string() == Int->get_string() && e2->getType()->get_string() == Float->get_string())
-  {
-    emit_mrmov(RBP, varaddress1, RAX, s);
-    emit_int_to_float(RAX, XMM0, s);
-    emit_upmovsd(RBP, varaddress2, XMM1, s);
-    emit_ucompisd(XMM0, XMM1, s);
-    int pos1 = num_label++;
-    int pos2 = num_label++;
-    s << JA << " " << POSITION << pos1 << endl;
-    emit_mov("$0", RAX, s);
-    s << JMP << " " << POSITION << pos2 << endl;
-    s << POSITION << pos1 << ":" << endl;
-    emit_mov("$1", RAX, s);
-    s << POSITION << pos2 << ":" << endl;
-    emit_rmmov(RAX, 0, RBP, s);
-  }
-  else if (e1->getType()->get_string() == Float->get_string() && e2->getType()->get_string() == Float->get_string())
-  {
-    emit_upmovsd(RBP, varaddress1, XMM0, s);
-    emit_upmovsd(RBP, varaddress2, XMM1, s);
-    emit_ucompisd(XMM0, XMM1, s);
-    int pos1 = num_label++;
-    int pos2 = num_label++;
-    s << JA << " " << POSITION << pos1 << endl;
-    emit_mov("$0", RAX, s);
-    s << JMP << " " << POSITION << pos2 << endl;
-    s << POSITION << pos1 << ":" << endl;
-    emit_mov("$1", RAX, s);
-    s << POSITION << pos2 << ":" << endl;
-    emit_rmmov(RAX, offset, RBP, s);
-  }
+  Operand source = value_of(e1, b);
+  // a negative literal, like the divisor in x / -7
+  if (source.kind == Operand::INT)
+    b.result = Operand::imm(-(unsigned long long)source.ival);
+  else if (source.kind == Operand::FLOAT)
+    b.result = Operand::fimm(-source.fval);
+  else
+    b.result = b.unary(OP_NEG, ir_type(e1->getType()), source);
 }
 
-void And_class::code(ostream &s)
+void Lt_class::code(IRBuilder &b)
 {
-  e1->code(s);
-  int varaddress1 = tadd;
-  
-  e2->code(s);
-  int varaddress2 = tadd;
-
-  emit_sub("$8", RSP, s);
-  offset -= 8;
-  tadd = offset;
-
-  emit_mrmov(RBP, varaddress1, RAX, s);
-  emit_mrmov(RBP, varaddress2, RDX, s);
-  emit_and(RAX, RDX, s);
-  emit_rmmov(RDX, offset, RBP, s);
+  code_compare(e1, e2, REL_LT, b);
 }
 
-void Or_class::code(ostream &s)
+void Lt_class::code_cond(IRBuilder &b, BasicBlock *if_true, BasicBlock *if_false)
 {
-  e1->code(s);
-  int varaddress1 = tadd;
-  e2->code(s);
-  int varaddress2 = tadd;
-
-  emit_sub("$8", RSP, s);
-  offset -= 8;
-  tadd = offset;
-
-  emit_mrmov(RBP, varaddress1, RAX, s);
-  emit_mrmov(RBP, varaddress2, RDX, s);
-  emit_or(RAX, RDX, s);
-  emit_rmmov(RDX, offset, RBP, s);
+  code_compare_branch(e1, e2, REL_LT, b, if_true, if_false);
 }
 
-void Xor_class::code(ostream &s)
+void Le_class::code(IRBuilder &b)
 {
-  e1->code(s);
-  int varaddress1 = tadd;
-  e2->code(s);
-  int varaddress2 = tadd;
-
-  emit_sub("$8", RSP, s);
-  offset -= 8;
-  tadd = offset;
-
-  emit_mrmov(RBP, varaddress1, RAX, s);
-  emit_mrmov(RBP, varaddress2, RDX, s);
-  emit_xor(RAX, RDX, s);
-  emit_rmmov(RDX, offset, RBP, s);
+  code_compare(e1, e2, REL_LE, b);
 }
 
-void Not_class::code(ostream &s)
+void Le_class::code_cond(IRBuilder &b, BasicBlock *if_true, BasicBlock *if_false)
 {
-  e1->code(s);
-  int varaddress1 = tadd;
-
-  emit_sub("$8", RSP, s);
-  offset -= 8;
-  tadd = offset;
-
-  emit_mrmov(RBP, varaddress1, RAX, s);
-  emit_mov("$$0x0000000000000001", RDX, s);
-  emit_xor(RDX, RAX, s);
-  emit_rmmov(RAX, offset, RBX, s);
+  code_compare_branch(e1, e2, REL_LE, b, if_true, if_false);
 }
 
-void Bitnot_class::code(ostream &s)
+void Equ_class::code(IRBuilder &b)
 {
-  e1->code(s);
-  int varaddress1 = tadd;
+  code_compare(e1, e2, REL_EQ, b);
+}
 
-  emit_sub("$8", RSP, s);
-  offset -= 8;
-  tadd = offset;
+void Equ_class::code_cond(IRBuilder &b, BasicBlock *if_true, BasicBlock *if_false)
+{
+  code_compare_branch(e1, e2, REL_EQ, b, if_true, if_false);
+}
 
-  emit_mrmov(RBP, varaddress1, RAX, s);
-  emit_not(RAX, s);
-  emit_rmmov(RAX, offset, RBP, s);
+void Neq_class::code(IRBuilder &b)
+{
+  code_compare(e1, e2, REL_NE, b);
 }
 
-void Bitand_class::code(ostream &s)
+void Neq_class::code_cond(IRBuilder &b, BasicBlock *if_true, BasicBlock *if_false)
 {
-  e1->code(s);
-  int varaddress1 = tadd;
-  e2->code(s);
-  int varaddress2 = tadd;
+  code_compare_branch(e1, e2, REL_NE, b, if_true, if_false);
+}
 
-  emit_sub("$8", RSP, s);
-  offset -= 8;
-  tadd = offset;
+void Ge_class::code(IRBuilder &b)
+{
+  code_compare(e1, e2, REL_GE, b);
+}
 
-  emit_mrmov(RBP, varaddress1, RAX, s);
-  emit_mrmov(RBP, varaddress2, RDX, s);
-  emit_and(RAX, RDX, s);
-  emit_rmmov(RDX, offset, RBP, s);
+void Ge_class::code_cond(IRBuilder &b, BasicBlock *if_true, BasicBlock *if_false)
+{
+  code_compare_branch(e1, e2, REL_GE, b, if_true, if_false);
 }
 
-void Bitor_class::code(ostream &s)
+void Gt_class::code(IRBuilder &b)
 {
-  e1->code(s);
-  int varaddress1 = tadd;
-  e2->code(s);
-  int varaddress2 = tadd;
+  code_compare(e1, e2, REL_GT, b);
+}
 
-  emit_sub("$8", RSP, s);
-  offset -= 8;
-  tadd = offset;
+void Gt_class::code_cond(IRBuilder &b, BasicBlock *if_true, BasicBlock *if_false)
+{
+  code_compare_branch(e1, e2, REL_GT, b, if_true, if_false);
+}
 
-  emit_mrmov(RBP, varaddress1, RAX, s);
-  emit_mrmov(RBP, varaddress2, RDX, s);
-  emit_or(RAX, RDX, s);
-  emit_rmmov(RDX, offset, RBP, s);
+void And_class::code(IRBuilder &b)
+{
+  code_cond_value(this, b);
 }
 
-void Const_int_class::code(ostream &s)
+void And_class::code_cond(IRBuilder &b, BasicBlock *if_true, BasicBlock *if_false)
 {
-  emit_sub("$8", RSP, s);
-  offset -= 8;
-  tadd = offset;
+  BasicBlock *right = b.fn->new_block();
+  e1->code_cond(b, right, if_false);
+  b.start(right);
+  e2->code_cond(b, if_true, if_false);
+}
 
-  s << MOV << "$" << value << COMMA << RAX << endl;
+void Or_class::code(IRBuilder &b)
+{
+  code_cond_value(this, b);
+}
 
-  emit_rmmov(RAX, tadd, RBP, s);
+void Or_class::code_cond(IRBuilder &b, BasicBlock *if_true, BasicBlock *if_false)
+{
+  BasicBlock *right = b.fn->new_block();
+  e1->code_cond(b, if_true, right);
+  b.start(right);
+  e2->code_cond(b, if_true, if_false);
 }
 
-void Const_string_class::code(ostream &s)
+void Xor_class::code(IRBuilder &b)
 {
-  emit_sub("$8", RSP, s);
-  offset -= 8;
-  tadd = offset;
-  s << MOV;
-  stringtable.lookup_string(value->get_string())->code_ref(s);
-  s << COMMA << RAX << endl;
+  code_arith(e1, e2, OP_XOR, b);
+}
 
-  emit_rmmov(RAX, tadd, RBP, s);
+void Not_class::code(IRBuilder &b)
+{
+  Operand source = value_of(e1, b);
+  b.result = b.unary(OP_NOT, IR_BOOL, source);
 }
 
-void Const_float_class::code(ostream &s)
+void Not_class::code_cond(IRBuilder &b, BasicBlock *if_true, BasicBlock *if_false)
 {
-  emit_sub("$8", RSP, s);
-  offset -= 8;
-  tadd = offset;
+  e1->code_cond(b, if_false, if_true);
+}
 
-  double d_value = atof(value->get_string());
-  unsigned long long hex_value = *(unsigned long long *)&d_value;
-  char test[17];
-  sprintf(test, "%llx", hex_value);
+void Bitnot_class::code(IRBuilder &b)
+{
+  Operand source = value_of(e1, b);
+  b.result = b.unary(OP_NOT, IR_INT, source);
+}
 
-  s << MOV << "$0x";
-  s << test;
-  s << COMMA << RAX << endl;
+void Bitand_class::code(IRBuilder &b)
+{
+  code_arith(e1, e2, OP_AND, b);
+}
 
-  emit_rmmov(RAX, tadd, RBP, s);
+void Bitor_class::code(IRBuilder &b)
+{
+  code_arith(e1, e2, OP_OR, b);
 }
 
-void Const_bool_class::code(ostream &s)
+void Const_int_class::code(IRBuilder &b)
 {
-  offset -= 8;
-  emit_sub("$8", RSP, s);
-  
-  tadd = offset;
+  b.result = Operand::imm(strtoll(value->get_string(), NULL, 10));
+}
 
-  s << MOV << "$" << value << COMMA << RAX << endl;
+void Const_string_class::code(IRBuilder &b)
+{
+  b.result = Operand::str(stringtable.lookup_string(value->get_string()));
+}
 
-  emit_rmmov(RAX, tadd, RBP, s);
+void Const_float_class::code(IRBuilder &b)
+{
+  b.result = Operand::fimm(atof(value->get_string()));
 }
 
-void Object_class::code(ostream &s)
+void Const_bool_class::code(IRBuilder &b)
 {
-  objectmap.enterscope();
-  tadd = *objectmap.lookup(var);
+  b.result = Operand::imm(value ? 1 : 0);
+}
 
+void Const_bool_class::code_cond(IRBuilder &b, BasicBlock *if_true, BasicBlock *if_false)
+{
+  b.jump(value ? if_true : if_false);
+}
 
-  objectmap.exitscope();
+void Object_class::code(IRBuilder &b)
+{
+  int *var = b.vars.lookup(this->var);
+  if (var != NULL)
+  {
+    b.result = Operand::vreg(*var);
+    return;
+  }
+  // a global variable
+  b.result = b.load(this->var, ir_type(type));
 }
 
-void No_expr_class::code(ostream &s)
+void No_expr_class::code(IRBuilder &b)
 {
-}
\ No newline at end of file
+  b.result = Operand();
+}
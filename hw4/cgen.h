@@ -6,8 +6,19 @@
 #include "seal-stmt.h"
 #include "seal-expr.h"
 #include "symtab.h"
+#include "regalloc.h"
+#include "peephole.h"
+#include "ir.h"
+#include "opt.h"
+#include "x86.h"
+#include <algorithm>
+#include <limits.h>
+#include <string.h>
 #include <map>
+#include <set>
+#include <sstream>
 #include <string>
+#include <vector>
 #include "list.h"
 
 #define TRUE 1
@@ -29,6 +29,7 @@
 #define FLOATTAG                "\t.long\t"
 #define BOOLTAG                 "\t.long\t"
 #define ALIGN                   "\t.align\t"
+#define P2ALIGN                 "\t.p2align\t"
 
 // comma
 #define COMMA                   ", "
@@ -37,7 +38,10 @@
 #define SECTION                 "\t.section\t"
 #define TEXT                    "\t.text\t"
 #define RODATA                  "\t.rodata\t"
+#define RODATA_STR              ".rodata.str1.1,\"aMS\",@progbits,1"
 #define DATA                    "\t.data\t"
+#define BSS                     "\t.bss\t"
+#define FINI_ARRAY              ".fini_array,\"aw\""
 #define OBJECT                  "@object"
 #define FUNCTION                "@function"
 #define SIZE                    "\t.size\t"
@@ -46,6 +50,8 @@
 #define STRINGCONST_PREFIX      ".LC"
 #define FLOATCONST_PREFIX       ".FL"
 #define POSITION                ".POS"
+#define MEMO_PREFIX             ".MEMO"
+#define MEMO_BODY_SUFFIX        ".uncached"
 //
 // register names
 //
@@ -74,6 +80,14 @@
 #define XMM5    "%xmm5"     // float register
 #define XMM6    "%xmm6"     // float register
 #define XMM7    "%xmm7"     // float register
+#define XMM8    "%xmm8"     // float register
+#define XMM9    "%xmm9"     // float register
+#define XMM10   "%xmm10"    // float register
+#define XMM11   "%xmm11"    // float register
+#define XMM12   "%xmm12"    // float register
+#define XMM13   "%xmm13"    // float register
+#define XMM14   "%xmm14"    // float register
+#define XMM15   "%xmm15"    // float register
 
 //
 // Opcodes
@@ -88,6 +102,8 @@
 
 #define ADD     "\taddq\t"
 #define NEG     "\tnegq\t"
+#define LEA     "\tleaq\t"
+#define BTC     "\tbtcq\t"
 #define SUB     "\tsubq\t"     
 #define DIV     "\tidivq\t"
 #define CQTO    "\tcqto\t"
@@ -96,6 +112,9 @@
 #define OR      "\torq\t"
 #define NOT     "\tnotq\t"
 #define XOR     "\txorq\t"
+#define SHL     "\tshlq\t"
+#define SHR     "\tshrq\t"
+#define SAR     "\tsarq\t"
 #define CMP     "\tcmpq\t"
 #define JMP     "\tjmp\t"
 #define JL      "\tjl\t"
@@ -107,6 +126,13 @@
 #define TEST    "\ttestq\t"
 #define JZ      "\tjz\t"
 #define JNZ     "\tjnz\t"
+#define SET     "\tset"        // + the condition code of a jump
+#define CMOV    "\tcmov"       // + the condition code of a jump
+#define MOVZBQ  "\tmovzbq\t"
+#define ANDB    "\tandb\t"
+#define ORB     "\torb\t"
+#define AL      "%al"       // low byte of %rax
+#define CL      "%cl"       // low byte of %rcx
 // float
 #define MOVSD   "\tmovsd\t" 
 
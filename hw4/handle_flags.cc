@@ -8,6 +8,7 @@
 #include <stdlib.h>
 #include "seal-io.h"
 #include <unistd.h>
+#include <getopt.h>
 #include "cgen_gc.h"
 
 //
@@ -28,6 +29,9 @@ extern int seal_yydebug;        // for the parser
        int semant_debug;        // for semantic analysis
        int cgen_debug;          // for code gen
        bool disable_reg_alloc;  // Don't do register allocation
+       int emit_ir;             // print the IR instead of assembly
+       int inline_limit;        // the largest function inlined under -O
+       int memoize;             // cache the results of pure recursive functions
 
        int cgen_optimize;       // optimize switch for code generator 
        char *out_filename;      // file name for generated code
@@ -39,6 +43,14 @@ extern int seal_yydebug;        // for the parser
 extern int optind, opterr;
 extern char *optarg;
 
+// long options, which may also be given with a single '-'
+static struct option long_options[] = {
+  {"emit-ir", no_argument, &emit_ir, 1},
+  {"inline-limit", required_argument, NULL, 'i'},
+  {"memoize", no_argument, &memoize, 1},
+  {0, 0, 0, 0}
+};
+
 void handle_flags(int argc, char *argv[]) {
   int c;
   int unknownopt = 0;
@@ -51,10 +63,14 @@ void handle_flags(int argc, char *argv[]) {
   cgen_debug = 0;
   cgen_optimize = 0;
   disable_reg_alloc = 0;
-  
+  emit_ir = 0;
+  inline_limit = 30;
+  memoize = 0;
 
-  while ((c = getopt(argc, argv, "lpscvrOo:gtT")) != -1) {
+  while ((c = getopt_long_only(argc, argv, "lpscvrOo:gtT", long_options, NULL)) != -1) {
     switch (c) {
+    case 0:     // a long option that sets a flag
+      break;
 #ifdef DEBUG
     case 'l':
       yy_flex_debug = 1;
@@ -99,6 +115,9 @@ void handle_flags(int argc, char *argv[]) {
     case 'O':  // enable optimization
       cgen_optimize = 1;
       break;
+    case 'i':  // -inline-limit=N: inline functions of up to N IR instructions
+      inline_limit = atoi(optarg);
+      break;
     case '?':
       unknownopt = 1;
       break;
@@ -111,9 +130,9 @@ void handle_flags(int argc, char *argv[]) {
   if (unknownopt) {
       cerr << "usage: " << argv[0] << 
 #ifdef DEBUG
-	  " [-lvpscOgtTr -o outname] [input-files]\n";
+	  " [-lvpscOgtTr -emit-ir -inline-limit=N -memoize -o outname] [input-files]\n";
 #else
-      " [-OgtT -o outname] [input-files]\n";
+      " [-OgtT -emit-ir -inline-limit=N -memoize -o outname] [input-files]\n";
 #endif
       exit(1);
   }
@@ -0,0 +1,460 @@
+
+//**************************************************************
+//
+// The intermediate representation, see ir.h.
+//
+//**************************************************************
+
+#include <stdio.h>
+#include <string.h>
+#include "ir.h"
+#include "utilities.h"
+
+bool Operand::operator==(const Operand &o) const
+{
+  if (kind != o.kind)
+    return false;
+  switch (kind)
+  {
+  case VREG:
+    return reg == o.reg;
+  case INT:
+    return ival == o.ival;
+  case STRING:
+    return sym == o.sym;
+  case FLOAT:
+    // the same bits: 0.0 is not -0.0, and a NaN is itself
+    return memcmp(&fval, &o.fval, sizeof(fval)) == 0;
+  default:
+    return true;
+  }
+}
+
+void IRInst::uses(std::vector<int> &vregs) const
+{
+  if (a.is_vreg())
+    vregs.push_back(a.reg);
+  if (b.is_vreg())
+    vregs.push_back(b.reg);
+  for (size_t i = 0; i < args.size(); i++)
+    if (args[i].is_vreg())
+      vregs.push_back(args[i].reg);
+}
+
+//////////////////////////////////////////////////////////////////////
+//
+// Functions and their control-flow graph
+//
+//////////////////////////////////////////////////////////////////////
+
+IRFunction::~IRFunction()
+{
+  for (size_t i = 0; i < all_blocks.size(); i++)
+    delete all_blocks[i];
+}
+
+int IRFunction::new_vreg(IRType type, Symbol var)
+{
+  vreg_type.push_back(type);
+  vreg_name.push_back(var);
+  return vreg_type.size() - 1;
+}
+
+BasicBlock *IRFunction::new_block()
+{
+  BasicBlock *bb = new BasicBlock(all_blocks.size());
+  all_blocks.push_back(bb);
+  return bb;
+}
+
+// The block a jump to bb ends up in, passing through blocks that only jump.
+static BasicBlock *jump_destination(BasicBlock *bb)
+{
+  for (size_t steps = 0; steps < 64; steps++)
+  {
+    if (bb->insts.size() != 1 || bb->insts[0].op != OP_JMP ||
+        bb->insts[0].target[0] == bb)
+      break;
+    bb = bb->insts[0].target[0];
+  }
+  return bb;
+}
+
+void IRFunction::compute_cfg()
+{
+  for (size_t i = 0; i < blocks.size(); i++)
+  {
+    IRInst &term = blocks[i]->terminator();
+    for (int k = 0; k < 2; k++)
+      if (term.target[k] != NULL)
+        term.target[k] = jump_destination(term.target[k]);
+    if (term.op == OP_CBR && term.target[0] == term.target[1])
+    {
+      IRInst jump(OP_JMP);
+      jump.target[0] = term.target[0];
+      term = jump;
+    }
+  }
+
+  std::vector<bool> reached(all_blocks.size(), false);
+  std::vector<BasicBlock *> work(1, blocks[0]);
+  reached[blocks[0]->id] = true;
+  while (!work.empty())
+  {
+    BasicBlock *bb = work.back();
+    work.pop_back();
+    bb->preds.clear();
+    bb->succs.clear();
+    IRInst &term = bb->terminator();
+    for (int k = 0; k < 2; k++)
+    {
+      BasicBlock *succ = term.target[k];
+      if (succ != NULL && !reached[succ->id])
+      {
+        reached[succ->id] = true;
+        work.push_back(succ);
+      }
+    }
+  }
+
+  std::vector<BasicBlock *> kept;
+  for (size_t i = 0; i < blocks.size(); i++)
+    if (reached[blocks[i]->id])
+      kept.push_back(blocks[i]);
+  blocks.swap(kept);
+  for (size_t i = 0; i < blocks.size(); i++)
+  {
+    IRInst &term = blocks[i]->terminator();
+    for (int k = 0; k < 2; k++)
+    {
+      if (term.target[k] == NULL)
+        continue;
+      blocks[i]->succs.push_back(term.target[k]);
+      term.target[k]->preds.push_back(blocks[i]);
+    }
+  }
+}
+
+bool VregSet::merge(const VregSet &other)
+{
+  bool changed = false;
+  for (size_t k = 0; k < words.size(); k++)
+  {
+    unsigned long long w = words[k] | other.words[k];
+    changed |= w != words[k];
+    words[k] = w;
+  }
+  return changed;
+}
+
+bool VregSet::merge(const VregSet &other, const VregSet &minus)
+{
+  bool changed = false;
+  for (size_t k = 0; k < words.size(); k++)
+  {
+    unsigned long long w = words[k] | (other.words[k] & ~minus.words[k]);
+    changed |= w != words[k];
+    words[k] = w;
+  }
+  return changed;
+}
+
+void VregSet::members(std::vector<int> &out) const
+{
+  for (size_t k = 0; k < words.size(); k++)
+    for (unsigned long long w = words[k]; w != 0; w &= w - 1)
+      out.push_back(64 * k + __builtin_ctzll(w));
+}
+
+IRLiveness::IRLiveness(IRFunction &fn)
+{
+  size_t nblocks = fn.all_blocks.size();
+  size_t nvregs = fn.vreg_type.size();
+  std::vector<VregSet> def(nblocks, VregSet(nvregs));
+  live_in.assign(nblocks, VregSet(nvregs));
+  live_out.assign(nblocks, VregSet(nvregs));
+  for (size_t i = 0; i < fn.blocks.size(); i++)
+  {
+    BasicBlock *bb = fn.blocks[i];
+    VregSet &use = live_in[bb->id], &d = def[bb->id];
+    for (size_t k = 0; k < bb->insts.size(); k++)
+    {
+      std::vector<int> read;
+      bb->insts[k].uses(read);
+      for (size_t r = 0; r < read.size(); r++)
+        if (!d.has(read[r]))
+          use.add(read[r]);
+      if (bb->insts[k].dst >= 0)
+        d.add(bb->insts[k].dst);
+    }
+  }
+
+  // live_in starts as the vregs read before written, and only grows.
+  for (bool changed = true; changed;)
+  {
+    changed = false;
+    for (size_t i = fn.blocks.size(); i-- > 0;)
+    {
+      BasicBlock *bb = fn.blocks[i];
+      VregSet &out = live_out[bb->id];
+      for (size_t k = 0; k < bb->succs.size(); k++)
+        out.merge(live_in[bb->succs[k]->id]);
+      changed |= live_in[bb->id].merge(out, def[bb->id]);
+    }
+  }
+}
+
+//////////////////////////////////////////////////////////////////////
+//
+// Dumping, for -emit-ir
+//
+//////////////////////////////////////////////////////////////////////
+
+const char *ir_type_name(IRType type)
+{
+  static const char *names[] = {"Void", "Int", "Float", "Bool", "String"};
+  return names[type];
+}
+
+static const char *opcode_name(Opcode op)
+{
+  static const char *names[] = {"mov", "add", "sub", "mul", "div", "mod", "and",
+                                "or", "xor", "neg", "not", "i2f", "cmp", "select", "load",
+                                "store", "call", "jmp", "cbr", "ret"};
+  return names[op];
+}
+
+static const char *relation_name(Relation rel)
+{
+  static const char *names[] = {"lt", "le", "eq", "ne", "ge", "gt"};
+  return names[rel];
+}
+
+static ostream &operator<<(ostream &s, const Operand &o)
+{
+  char buf[32];
+  switch (o.kind)
+  {
+  case Operand::VREG:
+    return s << "%" << o.reg;
+  case Operand::INT:
+    return s << o.ival;
+  case Operand::FLOAT:
+    snprintf(buf, sizeof(buf), "%.17g", o.fval);
+    return s << buf;
+  case Operand::STRING:
+    s << "\"";
+    print_escaped_string(s, o.sym->get_string());
+    return s << "\"";
+  default:
+    return s << "_";
+  }
+}
+
+static void dump_inst(const IRInst &inst, ostream &s)
+{
+  s << "\t";
+  if (inst.dst >= 0)
+    s << "%" << inst.dst << " = ";
+  switch (inst.op)
+  {
+  case OP_JMP:
+    s << "jmp B" << inst.target[0]->id;
+    break;
+  case OP_CBR:
+    s << "if " << relation_name(inst.rel) << " " << ir_type_name(inst.type) << " "
+      << inst.a << ", " << inst.b << " goto B" << inst.target[0]->id
+      << " else B" << inst.target[1]->id;
+    break;
+  case OP_RET:
+    s << "ret";
+    if (inst.a.kind != Operand::NONE)
+      s << " " << ir_type_name(inst.type) << " " << inst.a;
+    break;
+  case OP_LOAD:
+    s << "load " << ir_type_name(inst.type) << " @" << inst.name;
+    break;
+  case OP_STORE:
+    s << "store " << ir_type_name(inst.type) << " @" << inst.name << ", " << inst.a;
+    break;
+  case OP_CALL:
+    s << "call " << ir_type_name(inst.type) << " " << inst.name << "(";
+    for (size_t i = 0; i < inst.args.size(); i++)
+      s << (i ? ", " : "") << inst.args[i];
+    s << ")";
+    break;
+  case OP_CMP:
+    s << "cmp " << relation_name(inst.rel) << " " << ir_type_name(inst.type)
+      << " " << inst.a << ", " << inst.b;
+    break;
+  case OP_SELECT:
+    s << "select " << relation_name(inst.rel) << " " << ir_type_name(inst.type)
+      << " " << inst.a << ", " << inst.b << " ? " << inst.args[0] << " : "
+      << inst.args[1];
+    break;
+  default:
+    s << opcode_name(inst.op) << " " << ir_type_name(inst.type) << " " << inst.a;
+    if (inst.b.kind != Operand::NONE)
+      s << ", " << inst.b;
+    break;
+  }
+  s << endl;
+}
+
+void IRFunction::dump(ostream &s)
+{
+  s << "function " << name << "(";
+  for (size_t i = 0; i < params.size(); i++)
+    s << (i ? ", " : "") << "%" << params[i];
+  s << ") : " << ir_type_name(ret_type) << (memoized ? " memoized" : "") << endl;
+  for (size_t v = 0; v < vreg_name.size(); v++)
+    if (vreg_name[v] != NULL)
+      s << "\t# %" << v << " " << vreg_name[v] << " : "
+        << ir_type_name(vreg_type[v]) << endl;
+  for (size_t i = 0; i < blocks.size(); i++)
+  {
+    BasicBlock *bb = blocks[i];
+    s << "B" << bb->id << ":";
+    if (!bb->preds.empty())
+    {
+      s << "\t\t\t# preds";
+      for (size_t k = 0; k < bb->preds.size(); k++)
+        s << " B" << bb->preds[k]->id;
+    }
+    s << endl;
+    for (size_t k = 0; k < bb->insts.size(); k++)
+      dump_inst(bb->insts[k], s);
+  }
+  s << endl;
+}
+
+//////////////////////////////////////////////////////////////////////
+//
+// Building
+//
+//////////////////////////////////////////////////////////////////////
+
+IRBuilder::IRBuilder(IRFunction *f)
+  : fn(f), block(NULL), break_target(NULL), continue_target(NULL)
+{
+  start(fn->new_block());
+}
+
+void IRBuilder::start(BasicBlock *bb)
+{
+  if (block != NULL && !block->terminated())
+    jump(bb);
+  fn->blocks.push_back(bb);
+  block = bb;
+}
+
+void IRBuilder::emit(const IRInst &inst)
+{
+  // Code after a jump or return is unreachable; it gets a block of its
+  // own, which compute_cfg drops.
+  if (block->terminated())
+    start(fn->new_block());
+  block->insts.push_back(inst);
+}
+
+Operand IRBuilder::binary(Opcode op, IRType type, Operand a, Operand b)
+{
+  IRInst inst(op, type);
+  inst.dst = fn->new_vreg(type);
+  inst.a = a;
+  inst.b = b;
+  emit(inst);
+  return Operand::vreg(inst.dst);
+}
+
+Operand IRBuilder::unary(Opcode op, IRType type, Operand a)
+{
+  IRInst inst(op, type);
+  inst.dst = fn->new_vreg(type);
+  inst.a = a;
+  emit(inst);
+  return Operand::vreg(inst.dst);
+}
+
+Operand IRBuilder::compare(Relation rel, IRType type, Operand a, Operand b)
+{
+  IRInst inst(OP_CMP, type);
+  inst.rel = rel;
+  inst.dst = fn->new_vreg(IR_BOOL);
+  inst.a = a;
+  inst.b = b;
+  emit(inst);
+  return Operand::vreg(inst.dst);
+}
+
+void IRBuilder::move(int dst, Operand a)
+{
+  if (a.is_vreg() && fn->vreg_name[a.reg] == NULL && !block->insts.empty() &&
+      block->insts.back().dst == a.reg && fn->vreg_type[a.reg] == fn->vreg_type[dst])
+  {
+    block->insts.back().dst = dst;
+    return;
+  }
+  IRInst inst(OP_MOV, fn->vreg_type[dst]);
+  inst.dst = dst;
+  inst.a = a;
+  emit(inst);
+}
+
+Operand IRBuilder::load(Symbol global, IRType type)
+{
+  IRInst inst(OP_LOAD, type);
+  inst.dst = fn->new_vreg(type);
+  inst.name = global;
+  emit(inst);
+  return Operand::vreg(inst.dst);
+}
+
+void IRBuilder::store(Symbol global, Operand a)
+{
+  IRInst inst(OP_STORE);
+  inst.name = global;
+  inst.a = a;
+  if (a.is_vreg())
+    inst.type = fn->vreg_type[a.reg];
+  else
+    inst.type = a.kind == Operand::FLOAT ? IR_FLOAT : IR_INT;
+  emit(inst);
+}
+
+Operand IRBuilder::call(Symbol callee, IRType type, const std::vector<Operand> &args)
+{
+  IRInst inst(OP_CALL, type);
+  inst.name = callee;
+  inst.args = args;
+  if (type != IR_VOID)
+    inst.dst = fn->new_vreg(type);
+  emit(inst);
+  return type == IR_VOID ? Operand() : Operand::vreg(inst.dst);
+}
+
+void IRBuilder::jump(BasicBlock *target)
+{
+  IRInst inst(OP_JMP);
+  inst.target[0] = target;
+  emit(inst);
+}
+
+void IRBuilder::branch(Relation rel, IRType type, Operand a, Operand b,
+                       BasicBlock *if_true, BasicBlock *if_false)
+{
+  IRInst inst(OP_CBR, type);
+  inst.rel = rel;
+  inst.a = a;
+  inst.b = b;
+  inst.target[0] = if_true;
+  inst.target[1] = if_false;
+  emit(inst);
+}
+
+void IRBuilder::ret(Operand a)
+{
+  IRInst inst(OP_RET, fn->ret_type);
+  inst.a = a;
+  emit(inst);
+}
@@ -0,0 +1,198 @@
+#ifndef _IR_H_
+#define _IR_H_
+
+#include <string>
+#include <vector>
+#include "seal-io.h"
+#include "stringtab.h"
+#include "symtab.h"
+
+//
+// The intermediate representation between the AST and x86-64.
+//
+// A function is a control-flow graph of basic blocks holding three-address
+// instructions over an unbounded supply of virtual registers ("vregs").
+// Every local variable and parameter of the function is a vreg, and so is
+// every temporary; vregs may be assigned more than once.  Operations are
+// typed: both operands of an arithmetic operation or comparison already
+// have the operation's type, so an Int operand of a Float operation is
+// converted by an explicit OP_I2F.
+//
+// The last instruction of every block, and only that one, is a terminator:
+// OP_JMP, OP_CBR or OP_RET.  The order of IRFunction::blocks is the order
+// the backend lays the blocks out in; blocks[0] is the entry.
+//
+
+enum IRType { IR_VOID, IR_INT, IR_FLOAT, IR_BOOL, IR_STRING };
+
+enum Relation { REL_LT, REL_LE, REL_EQ, REL_NE, REL_GE, REL_GT };
+
+struct Operand
+{
+  enum Kind { NONE, VREG, INT, FLOAT, STRING } kind;
+  int reg;              // VREG: the vreg
+  long long ival;       // INT: the value
+  double fval;          // FLOAT: the value
+  Symbol sym;           // STRING: the string table entry
+
+  Operand() : kind(NONE), reg(-1), ival(0), fval(0), sym(NULL) { }
+  static Operand vreg(int r)        { Operand o; o.kind = VREG; o.reg = r; return o; }
+  static Operand imm(long long v)   { Operand o; o.kind = INT; o.ival = v; return o; }
+  static Operand fimm(double v)     { Operand o; o.kind = FLOAT; o.fval = v; return o; }
+  static Operand str(Symbol s)      { Operand o; o.kind = STRING; o.sym = s; return o; }
+
+  bool is_vreg() const  { return kind == VREG; }
+  bool is_const() const { return kind == INT || kind == FLOAT || kind == STRING; }
+  bool operator==(const Operand &o) const;
+  bool operator!=(const Operand &o) const { return !(*this == o); }
+};
+
+enum Opcode
+{
+  OP_MOV,       // dst = a
+  OP_ADD,       // dst = a + b              Int, Float
+  OP_SUB,       // dst = a - b              Int, Float
+  OP_MUL,       // dst = a * b              Int, Float
+  OP_DIV,       // dst = a / b              Int (truncating), Float
+  OP_MOD,       // dst = a % b              Int
+  OP_AND,       // dst = a & b              Int
+  OP_OR,        // dst = a | b              Int
+  OP_XOR,       // dst = a ^ b              Int, Bool
+  OP_NEG,       // dst = -a                 Int, Float
+  OP_NOT,       // dst = ~a, or !a          Int, Bool
+  OP_I2F,       // dst = (Float) a
+  OP_CMP,       // dst = a rel b            a Bool, of two operands of type
+  OP_SELECT,    // dst = a rel b ? args[0] : args[1]    not a Float
+  OP_LOAD,      // dst = the global name
+  OP_STORE,     // the global name = a
+  OP_CALL,      // dst = name(args), or name(args) if dst < 0
+  OP_JMP,       // goto target[0]
+  OP_CBR,       // if a rel b goto target[0] else goto target[1]
+  OP_RET        // return a, or return if a is NONE
+};
+
+struct BasicBlock;
+
+struct IRInst
+{
+  Opcode op;
+  IRType type;                  // of the result; of a and b for OP_CMP, OP_SELECT, OP_CBR
+  Relation rel;                 // OP_CMP, OP_SELECT, OP_CBR
+  int dst;                      // the vreg written, or -1
+  Operand a, b;
+  std::vector<Operand> args;    // OP_CALL, OP_SELECT
+  Symbol name;                  // OP_LOAD, OP_STORE, OP_CALL
+  BasicBlock *target[2];        // OP_JMP, OP_CBR
+
+  IRInst(Opcode o, IRType t = IR_VOID) : op(o), type(t), rel(REL_EQ), dst(-1), name(NULL)
+  {
+    target[0] = target[1] = NULL;
+  }
+  bool is_terminator() const { return op == OP_JMP || op == OP_CBR || op == OP_RET; }
+  void uses(std::vector<int> &vregs) const;     // append the vregs read
+};
+
+struct BasicBlock
+{
+  int id;
+  std::vector<IRInst> insts;
+  std::vector<BasicBlock *> preds, succs;
+  bool align;                   // heads a loop: start it on a fetch boundary
+
+  explicit BasicBlock(int n) : id(n), align(false) { }
+  IRInst &terminator() { return insts.back(); }
+  bool terminated() const { return !insts.empty() && insts.back().is_terminator(); }
+};
+
+struct IRFunction
+{
+  Symbol name;
+  IRType ret_type;
+  std::vector<IRType> vreg_type;
+  std::vector<Symbol> vreg_name;        // the variable held, or NULL
+  std::vector<int> params;              // the parameters' vregs, in order
+  std::vector<BasicBlock *> blocks;     // reachable blocks, in layout order
+  std::vector<BasicBlock *> all_blocks; // every block created, for deletion
+  bool memoized;                        // called through a cache of results
+
+  IRFunction(Symbol n, IRType t) : name(n), ret_type(t), memoized(false) { }
+  ~IRFunction();
+
+  int new_vreg(IRType type, Symbol var = NULL);
+  BasicBlock *new_block();
+
+  // Recompute preds and succs, short-circuiting jumps to blocks that only
+  // jump on and dropping the blocks that cannot be reached.
+  void compute_cfg();
+
+  void dump(ostream &s);
+};
+
+//
+// A set of vregs, one bit each, packed into words.
+//
+class VregSet
+{
+  std::vector<unsigned long long> words;
+public:
+  explicit VregSet(size_t n = 0) : words((n + 63) / 64, 0) { }
+  bool has(int v) const { return (words[v / 64] >> (v % 64)) & 1; }
+  void add(int v) { words[v / 64] |= 1ULL << (v % 64); }
+  void remove(int v) { words[v / 64] &= ~(1ULL << (v % 64)); }
+  // Add the members of other, less those of minus; true if any was new.
+  bool merge(const VregSet &other);
+  bool merge(const VregSet &other, const VregSet &minus);
+  // Append the members, in increasing order.
+  void members(std::vector<int> &out) const;
+};
+
+//
+// The vregs live on entry to and on exit from each block, indexed by the
+// block's id.  Needs the preds and succs from compute_cfg.
+//
+struct IRLiveness
+{
+  std::vector<VregSet> live_in, live_out;
+
+  explicit IRLiveness(IRFunction &fn);
+};
+
+//
+// The state of lowering one function's AST: where the next instruction
+// goes, the value of the expression lowered last, the vregs of the
+// variables in scope, and the targets of break and continue.
+//
+class IRBuilder
+{
+public:
+  IRFunction *fn;
+  BasicBlock *block;                    // the block being filled
+  Operand result;                       // the value of the last expression
+  SymbolTable<Symbol, int> vars;        // variable -> vreg; globals are absent
+  BasicBlock *break_target;
+  BasicBlock *continue_target;
+
+  explicit IRBuilder(IRFunction *f);
+
+  // Continue in bb, placing it after the blocks placed so far.
+  void start(BasicBlock *bb);
+  void emit(const IRInst &inst);
+
+  Operand binary(Opcode op, IRType type, Operand a, Operand b);
+  Operand unary(Opcode op, IRType type, Operand a);
+  Operand compare(Relation rel, IRType type, Operand a, Operand b);
+  // dst = a.  A temporary defined by the last instruction is used nowhere
+  // else, so that instruction is made to define dst instead.
+  void move(int dst, Operand a);
+  Operand load(Symbol global, IRType type);
+  void store(Symbol global, Operand a);
+  Operand call(Symbol callee, IRType type, const std::vector<Operand> &args);
+  void jump(BasicBlock *target);
+  void branch(Relation rel, IRType type, Operand a, Operand b,
+              BasicBlock *if_true, BasicBlock *if_false);
+  void ret(Operand a);
+};
+
+const char *ir_type_name(IRType type);
+
+#endif
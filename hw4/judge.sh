@@ -1,20 +1,55 @@
 #!/bin/bash
+# Each test is compiled without -O, with it, with it but memoizing instead
+# of inlining, and with -r keeping every variable on the stack, with and
+# without -O.  Its output is compared with the answer program, or with the
+# saved output where there is none.
 cd test
+
+judge() {
+    result=passed
+    for flags in "-O -inline-limit=0 -memoize" "-O" "" "-r" "-O -r"; do
+        (ulimit -v 1048576; timeout 10 ../cgen $1.seal -o $1.s $flags)
+        gcc $1.s -o $1 -no-pie
+        ./$1 > tempfile 2> /dev/null
+        diff tempfile tempfile2 > /dev/null || result="NOT passed"
+        rm -f $1
+    done
+    echo $result
+}
+
 for filename in *.seal; do
     echo "--------Test using" $filename "--------"
     name=${filename//.seal}
-    ../cgen $filename -o $name.s
-    gcc $name.s -o $name -no-pie
-    ./$name > tempfile
-    ../test-answer/$name > tempfile2
-    diff tempfile tempfile2 > /dev/null
-    if [ $? -eq 0 ] ; then
-        echo passed
+    if [ -x ../test-answer/$name ] ; then
+        ../test-answer/$name > tempfile2
     else
-        echo NOT passed
+        cp ../test-answer/$name.out tempfile2
     fi
-    rm -f $name
+    judge $name
 done
 
+# One function with 3000 locals, each behind a branch: under the limits
+# above, it fails any pass whose time or memory grows as blocks x variables.
+echo "--------Test using 3000 locals --------"
+{
+    echo "func main() Void{"
+    for ((i = 0; i < 3000; i++)); do
+        echo "    var v$i Int;"
+    done
+    echo "    v0 = 0;"
+    for ((i = 1; i < 3000; i++)); do
+        echo "    v$i = v$((i - 1)) + 1;"
+        echo "    if v$i > 5000 {"
+        echo "        v$i = 0;"
+        echo "    }"
+    done
+    echo "    printf(\"%lld\\n\", v2999);"
+    echo "    return;"
+    echo "}"
+} > locals.seal
+echo 2999 > tempfile2
+judge locals
+rm -f locals.seal locals.s
+
 rm -f tempfile tempfile2
-cd ..
\ No newline at end of file
+cd ..
@@ -0,0 +1,2170 @@
+
+//**************************************************************
+//
+// Optimizations on the IR, see opt.h.
+//
+//**************************************************************
+
+#include <algorithm>
+#include <limits.h>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string.h>
+#include "opt.h"
+
+extern int inline_limit;
+extern int memoize;
+
+//////////////////////////////////////////////////////////////////////
+//
+// Constant folding
+//
+// An operation whose operands are all constants is evaluated here, with
+// the semantics of the code the backend emits for it: Int arithmetic
+// wraps around, / and % truncate toward zero, Float arithmetic is IEEE
+// double, and a Float comparison involving a NaN holds only for !=.  What
+// would trap at run time -- an Int division by 0, or of the most negative
+// Int by -1 -- is left alone, and so is % on Floats.
+//
+//////////////////////////////////////////////////////////////////////
+
+static bool holds(Relation rel, long long x, long long y)
+{
+  switch (rel)
+  {
+  case REL_LT:
+    return x < y;
+  case REL_LE:
+    return x <= y;
+  case REL_EQ:
+    return x == y;
+  case REL_NE:
+    return x != y;
+  case REL_GE:
+    return x >= y;
+  default:
+    return x > y;
+  }
+}
+
+static bool holds(Relation rel, double x, double y)
+{
+  switch (rel)
+  {
+  case REL_LT:
+    return x < y;
+  case REL_LE:
+    return x <= y;
+  case REL_EQ:
+    return x == y;
+  case REL_NE:
+    return x != y;
+  case REL_GE:
+    return x >= y;
+  default:
+    return x > y;
+  }
+}
+
+// Does "a rel b" fold to a constant?  Only Int, Bool and Float compare.
+static bool fold_relation(Relation rel, const Operand &a, const Operand &b, bool &result)
+{
+  if (a.kind == Operand::INT && b.kind == Operand::INT)
+    result = holds(rel, a.ival, b.ival);
+  else if (a.kind == Operand::FLOAT && b.kind == Operand::FLOAT)
+    result = holds(rel, a.fval, b.fval);
+  else
+    return false;
+  return true;
+}
+
+static bool fold_int(Opcode op, IRType type, long long x, long long y, long long &result)
+{
+  unsigned long long ux = x, uy = y;
+  switch (op)
+  {
+  case OP_ADD:
+    result = ux + uy;
+    return true;
+  case OP_SUB:
+    result = ux - uy;
+    return true;
+  case OP_MUL:
+    result = ux * uy;
+    return true;
+  case OP_DIV:
+  case OP_MOD:
+    if (y == 0 || (x == LLONG_MIN && y == -1))
+      return false;
+    result = op == OP_DIV ? x / y : x % y;
+    return true;
+  case OP_AND:
+    result = x & y;
+    return true;
+  case OP_OR:
+    result = x | y;
+    return true;
+  case OP_XOR:
+    result = x ^ y;
+    return true;
+  case OP_NEG:
+    result = -ux;
+    return true;
+  case OP_NOT:
+    result = type == IR_BOOL ? x ^ 1 : ~x;
+    return true;
+  default:
+    return false;
+  }
+}
+
+static bool fold_float(Opcode op, double x, double y, double &result)
+{
+  switch (op)
+  {
+  case OP_ADD:
+    result = x + y;
+    return true;
+  case OP_SUB:
+    result = x - y;
+    return true;
+  case OP_MUL:
+    result = x * y;
+    return true;
+  case OP_DIV:
+    result = x / y;
+    return true;
+  case OP_NEG:
+    result = -x;
+    return true;
+  default:
+    return false;
+  }
+}
+
+//
+// The constant inst computes from the operands a and b, if it does.
+//
+static bool fold(const IRInst &inst, const Operand &a, const Operand &b, Operand &result)
+{
+  bool unary = inst.op == OP_NEG || inst.op == OP_NOT;
+  switch (inst.op)
+  {
+  case OP_MOV:
+    result = a;
+    return a.is_const();
+  case OP_I2F:
+    if (a.kind != Operand::INT)
+      return false;
+    result = Operand::fimm((double)a.ival);
+    return true;
+  case OP_CMP:
+  {
+    bool holds;
+    if (!fold_relation(inst.rel, a, b, holds))
+      return false;
+    result = Operand::imm(holds);
+    return true;
+  }
+  case OP_SELECT:
+  {
+    bool holds;
+    if (!fold_relation(inst.rel, a, b, holds))
+      return false;
+    result = inst.args[holds ? 0 : 1];
+    return result.is_const();
+  }
+  case OP_ADD:
+  case OP_SUB:
+  case OP_MUL:
+  case OP_DIV:
+  case OP_MOD:
+  case OP_AND:
+  case OP_OR:
+  case OP_XOR:
+  case OP_NEG:
+  case OP_NOT:
+    if (a.kind == Operand::INT && (unary || b.kind == Operand::INT))
+    {
+      long long value;
+      if (!fold_int(inst.op, inst.type, a.ival, b.ival, value))
+        return false;
+      result = Operand::imm(value);
+      return true;
+    }
+    if (a.kind == Operand::FLOAT && (unary || b.kind == Operand::FLOAT))
+    {
+      double value;
+      if (!fold_float(inst.op, a.fval, b.fval, value))
+        return false;
+      result = Operand::fimm(value);
+      return true;
+    }
+    return false;
+  default:
+    return false;
+  }
+}
+
+//
+// The operand an Int operation with one constant operand leaves unchanged,
+// as in x + 0 or 1 * x, if it does.
+//
+static bool identity(const IRInst &inst, Operand &result)
+{
+  if (inst.type != IR_INT)
+    return false;
+  long long unit = inst.op == OP_MUL || inst.op == OP_DIV ? 1 : 0;
+  bool commutes = inst.op != OP_SUB && inst.op != OP_DIV;
+  switch (inst.op)
+  {
+  case OP_ADD:
+  case OP_SUB:
+  case OP_MUL:
+  case OP_DIV:
+  case OP_OR:
+  case OP_XOR:
+    if (inst.b == Operand::imm(unit))
+      result = inst.a;
+    else if (commutes && inst.a == Operand::imm(unit))
+      result = inst.b;
+    else
+      return false;
+    return true;
+  default:
+    return false;
+  }
+}
+
+//////////////////////////////////////////////////////////////////////
+//
+// Constant propagation
+//
+// Sparse conditional constant propagation over the blocks: every vreg has
+// a value in the lattice undefined > constant > varying at the entry and
+// exit of each block, and a block's entry is the meet of the exits of the
+// predecessors whose edge to it can be taken.  A conditional branch that
+// folds only makes the edge it takes executable, so the constants of a
+// branch never taken do not spoil the meet, and a branch on a value still
+// undefined takes no edge at all.  Parameters and variables read before
+// they are written are varying at the entry of the function.
+//
+// Only the vregs live across an edge can differ between the blocks it
+// joins, so a block keeps values for its live-in and live-out vregs and
+// nothing else, and a block is looked at again only when one of the vregs
+// live into it changes or a new edge to it becomes executable.
+//
+//////////////////////////////////////////////////////////////////////
+
+struct LatticeValue
+{
+  enum State { UNDEF, CONST, VARYING } state;
+  Operand value;
+
+  LatticeValue() : state(UNDEF) { }
+  explicit LatticeValue(State s) : state(s) { }
+  explicit LatticeValue(const Operand &c) : state(CONST), value(c) { }
+  bool operator!=(const LatticeValue &o) const
+  {
+    return state != o.state || (state == CONST && value != o.value);
+  }
+};
+
+static void meet(LatticeValue &into, const LatticeValue &v)
+{
+  if (v.state == LatticeValue::UNDEF || into.state == LatticeValue::VARYING)
+    return;
+  if (into.state == LatticeValue::UNDEF)
+    into = v;
+  else if (v.state == LatticeValue::VARYING || v.value != into.value)
+    into = LatticeValue(LatticeValue::VARYING);
+}
+
+typedef std::map<int, LatticeValue> ConstState;        // by vreg
+
+struct ConstPropagation
+{
+  IRFunction &fn;
+  IRLiveness liveness;
+  std::vector<ConstState> entry, exit;  // by block id, over what is live
+  std::set<std::pair<int, int> > edges; // executable (from, to)
+  std::vector<LatticeValue> local;      // by vreg, in the current block
+  std::vector<bool> assigned;           // there
+  std::vector<int> touched;             // the vregs assigned there
+  const ConstState *in;                 // its entry
+
+  explicit ConstPropagation(IRFunction &f);
+  void enter(BasicBlock *bb);
+  LatticeValue lookup(const Operand &o) const;
+  Operand known(const Operand &o) const;
+  void transfer(const IRInst &inst);
+  void taken_targets(BasicBlock *bb, std::vector<BasicBlock *> &targets) const;
+  std::vector<int> leave(BasicBlock *bb);
+};
+
+ConstPropagation::ConstPropagation(IRFunction &f)
+    : fn(f), liveness(f), entry(f.all_blocks.size()), exit(f.all_blocks.size()),
+      local(f.vreg_type.size()), assigned(f.vreg_type.size(), false), in(NULL)
+{
+}
+
+// Start looking at bb, from the meet of the executable edges into it.
+void ConstPropagation::enter(BasicBlock *bb)
+{
+  std::vector<int> live;
+  liveness.live_in[bb->id].members(live);
+  ConstState &state = entry[bb->id];
+  for (size_t i = 0; i < live.size(); i++)
+  {
+    LatticeValue value;
+    if (bb == fn.blocks[0])
+      value = LatticeValue(LatticeValue::VARYING);
+    for (size_t k = 0; k < bb->preds.size(); k++)
+      if (edges.count(std::make_pair(bb->preds[k]->id, bb->id)))
+        meet(value, exit[bb->preds[k]->id][live[i]]);
+    state[live[i]] = value;
+  }
+  in = &state;
+}
+
+// The value of o at this point of the current block.
+LatticeValue ConstPropagation::lookup(const Operand &o) const
+{
+  if (!o.is_vreg())
+    return LatticeValue(o);
+  if (assigned[o.reg])
+    return local[o.reg];
+  ConstState::const_iterator it = in->find(o.reg);
+  return it != in->end() ? it->second : LatticeValue(LatticeValue::VARYING);
+}
+
+// The operand o, replaced by its value if that is a constant.
+Operand ConstPropagation::known(const Operand &o) const
+{
+  LatticeValue v = lookup(o);
+  return v.state == LatticeValue::CONST ? v.value : o;
+}
+
+void ConstPropagation::transfer(const IRInst &inst)
+{
+  if (inst.dst < 0)
+    return;
+  LatticeValue result(LatticeValue::VARYING);
+  Operand folded;
+  if (inst.op != OP_CALL && inst.op != OP_LOAD)
+  {
+    if (lookup(inst.a).state == LatticeValue::UNDEF ||
+        lookup(inst.b).state == LatticeValue::UNDEF)
+      result = LatticeValue();
+    else if (fold(inst, known(inst.a), known(inst.b), folded))
+      result = LatticeValue(folded);
+  }
+  if (!assigned[inst.dst])
+  {
+    assigned[inst.dst] = true;
+    touched.push_back(inst.dst);
+  }
+  local[inst.dst] = result;
+}
+
+// The successors of bb whose edge can be taken, once its last
+// instruction went through transfer.
+void ConstPropagation::taken_targets(BasicBlock *bb, std::vector<BasicBlock *> &targets) const
+{
+  const IRInst &term = bb->terminator();
+  bool holds;
+  if (term.op == OP_JMP)
+    targets.push_back(term.target[0]);
+  else if (term.op != OP_CBR || lookup(term.a).state == LatticeValue::UNDEF ||
+           lookup(term.b).state == LatticeValue::UNDEF)
+    return;
+  else if (fold_relation(term.rel, known(term.a), known(term.b), holds))
+    targets.push_back(term.target[holds ? 0 : 1]);
+  else
+  {
+    targets.push_back(term.target[0]);
+    targets.push_back(term.target[1]);
+  }
+}
+
+// Stop looking at bb: record what it leaves in the vregs live out of it,
+// and return those whose value changed.
+std::vector<int> ConstPropagation::leave(BasicBlock *bb)
+{
+  std::vector<int> live, changed;
+  liveness.live_out[bb->id].members(live);
+  for (size_t i = 0; i < live.size(); i++)
+  {
+    LatticeValue value = lookup(Operand::vreg(live[i]));
+    std::pair<ConstState::iterator, bool> old =
+        exit[bb->id].insert(std::make_pair(live[i], value));
+    if (!old.second && old.first->second != value)
+    {
+      old.first->second = value;
+      changed.push_back(live[i]);
+    }
+  }
+  for (size_t i = 0; i < touched.size(); i++)
+    assigned[touched[i]] = false;
+  touched.clear();
+  return changed;
+}
+
+void propagate_constants(IRFunction &fn)
+{
+  size_t nblocks = fn.all_blocks.size();
+  ConstPropagation cp(fn);
+  std::vector<bool> reached(nblocks, false), queued(nblocks, false);
+  std::vector<BasicBlock *> work(1, fn.blocks[0]);
+  reached[fn.blocks[0]->id] = queued[fn.blocks[0]->id] = true;
+  while (!work.empty())
+  {
+    BasicBlock *bb = work.back();
+    work.pop_back();
+    queued[bb->id] = false;
+    cp.enter(bb);
+    for (size_t k = 0; k < bb->insts.size(); k++)
+      cp.transfer(bb->insts[k]);
+    std::vector<BasicBlock *> targets;
+    cp.taken_targets(bb, targets);
+    std::vector<int> changed = cp.leave(bb);
+
+    for (size_t k = 0; k < targets.size(); k++)
+    {
+      BasicBlock *next = targets[k];
+      bool new_edge = cp.edges.insert(std::make_pair(bb->id, next->id)).second;
+      bool affected = false;
+      for (size_t c = 0; c < changed.size() && !affected; c++)
+        affected = cp.liveness.live_in[next->id].has(changed[c]);
+      if ((new_edge || affected) && !queued[next->id])
+      {
+        reached[next->id] = queued[next->id] = true;
+        work.push_back(next);
+      }
+    }
+  }
+
+  // Rewrite, with the entry state of each block recomputed as above.
+  for (size_t i = 0; i < fn.blocks.size(); i++)
+  {
+    BasicBlock *bb = fn.blocks[i];
+    if (!reached[bb->id])
+      continue;
+    cp.enter(bb);
+    for (size_t k = 0; k < bb->insts.size(); k++)
+    {
+      IRInst &inst = bb->insts[k];
+      std::vector<BasicBlock *> targets;
+      if (inst.op == OP_CBR)
+        cp.taken_targets(bb, targets);
+      inst.a = cp.known(inst.a);
+      inst.b = cp.known(inst.b);
+      for (size_t n = 0; n < inst.args.size(); n++)
+        inst.args[n] = cp.known(inst.args[n]);
+      cp.transfer(inst);
+
+      Operand value;
+      if (inst.dst >= 0 && inst.op != OP_MOV && inst.op != OP_CALL &&
+          inst.op != OP_LOAD &&
+          (fold(inst, inst.a, inst.b, value) || identity(inst, value)))
+      {
+        IRInst move(OP_MOV, fn.vreg_type[inst.dst]);
+        move.dst = inst.dst;
+        move.a = value;
+        inst = move;
+      }
+      else if (inst.op == OP_CBR && targets.size() == 1)
+      {
+        IRInst jump(OP_JMP);
+        jump.target[0] = targets[0];
+        inst = jump;
+      }
+    }
+    cp.leave(bb);
+  }
+  fn.compute_cfg();
+}
+
+//////////////////////////////////////////////////////////////////////
+//
+// Dead code elimination
+//
+// Unreachable code never gets this far: lowering puts whatever follows a
+// return, break or continue in a block of its own, and compute_cfg drops
+// it along with the arms propagate_constants decides.  What is left is
+// the code that runs but computes nothing used: the value of an
+// expression statement, a store to a local that is overwritten or never
+// read, and whatever only fed those.  An instruction goes if the vreg it
+// writes is dead right after it and running it has no other effect.  A
+// vreg that no longer appears gets no location, so the frame shrinks too.
+//
+//////////////////////////////////////////////////////////////////////
+
+// Does inst do anything besides writing its dst?  An Int division may
+// trap, unless by a constant other than 0 and -1.
+static bool has_side_effects(const IRInst &inst)
+{
+  switch (inst.op)
+  {
+  case OP_STORE:
+  case OP_CALL:
+  case OP_JMP:
+  case OP_CBR:
+  case OP_RET:
+    return true;
+  case OP_DIV:
+  case OP_MOD:
+    return inst.type != IR_FLOAT &&
+           (inst.b.kind != Operand::INT || inst.b.ival == 0 || inst.b.ival == -1);
+  default:
+    return false;
+  }
+}
+
+void eliminate_dead_code(IRFunction &fn)
+{
+  for (bool changed = true; changed;)
+  {
+    changed = false;
+    IRLiveness liveness(fn);
+    for (size_t i = 0; i < fn.blocks.size(); i++)
+    {
+      BasicBlock *bb = fn.blocks[i];
+      VregSet live = liveness.live_out[bb->id];
+      std::vector<IRInst> kept;
+      for (size_t k = bb->insts.size(); k-- > 0;)
+      {
+        const IRInst &inst = bb->insts[k];
+        if (inst.dst >= 0 && !live.has(inst.dst) && !has_side_effects(inst))
+        {
+          changed = true;
+          continue;
+        }
+        if (inst.dst >= 0)
+          live.remove(inst.dst);
+        std::vector<int> read;
+        inst.uses(read);
+        for (size_t r = 0; r < read.size(); r++)
+          live.add(read[r]);
+        kept.push_back(inst);
+      }
+      bb->insts.assign(kept.rbegin(), kept.rend());
+    }
+    // Blocks left with only a jump are jumped over, and a branch whose
+    // arms now meet becomes a jump, which may free its operands too.
+    if (changed)
+      fn.compute_cfg();
+  }
+}
+
+//////////////////////////////////////////////////////////////////////
+//
+// Unused functions, globals and strings
+//
+// The whole program is at hand, so whatever main cannot reach is not
+// needed: the functions it never calls, directly or not, and the globals
+// and strings only those mention.  A global no reachable function loads
+// is never read either, so the stores to it go, and with them whatever
+// computed only the values stored.
+//
+//////////////////////////////////////////////////////////////////////
+
+static void use_operand(const Operand &o, ProgramUses &used)
+{
+  if (o.kind == Operand::STRING)
+    used.strings.insert(o.sym);
+}
+
+void eliminate_unused(std::vector<IRFunction *> &fns, Symbol entry, ProgramUses &used)
+{
+  std::map<Symbol, IRFunction *> by_name;
+  for (size_t i = 0; i < fns.size(); i++)
+    by_name[fns[i]->name] = fns[i];
+
+  std::set<Symbol> loaded;
+  std::vector<IRFunction *> work;
+  if (by_name.count(entry))
+  {
+    used.functions.insert(entry);
+    work.push_back(by_name[entry]);
+  }
+  while (!work.empty())
+  {
+    IRFunction *fn = work.back();
+    work.pop_back();
+    for (size_t i = 0; i < fn->blocks.size(); i++)
+      for (size_t k = 0; k < fn->blocks[i]->insts.size(); k++)
+      {
+        const IRInst &inst = fn->blocks[i]->insts[k];
+        if (inst.op == OP_LOAD)
+          loaded.insert(inst.name);
+        else if (inst.op == OP_CALL && by_name.count(inst.name) &&
+                 used.functions.insert(inst.name).second)
+          work.push_back(by_name[inst.name]);
+      }
+  }
+
+  std::vector<IRFunction *> kept;
+  for (size_t f = 0; f < fns.size(); f++)
+  {
+    IRFunction *fn = fns[f];
+    if (!used.functions.count(fn->name))
+    {
+      delete fn;
+      continue;
+    }
+    bool removed = false;
+    for (size_t i = 0; i < fn->blocks.size(); i++)
+    {
+      std::vector<IRInst> &insts = fn->blocks[i]->insts;
+      std::vector<IRInst> rest;
+      for (size_t k = 0; k < insts.size(); k++)
+      {
+        if (insts[k].op == OP_STORE && !loaded.count(insts[k].name))
+          removed = true;
+        else
+          rest.push_back(insts[k]);
+      }
+      insts.swap(rest);
+    }
+    if (removed)
+      eliminate_dead_code(*fn);
+
+    for (size_t i = 0; i < fn->blocks.size(); i++)
+      for (size_t k = 0; k < fn->blocks[i]->insts.size(); k++)
+      {
+        const IRInst &inst = fn->blocks[i]->insts[k];
+        if (inst.op == OP_LOAD || inst.op == OP_STORE)
+          used.globals.insert(inst.name);
+        use_operand(inst.a, used);
+        use_operand(inst.b, used);
+        for (size_t n = 0; n < inst.args.size(); n++)
+          use_operand(inst.args[n], used);
+      }
+    kept.push_back(fn);
+  }
+  fns.swap(kept);
+}
+
+//////////////////////////////////////////////////////////////////////
+//
+// Tail recursion
+//
+// A function that returns what calling itself returns does not need a new
+// frame for the call: it can assign the arguments to its parameters and
+// jump back to its start.  The same goes for returning "x op f(...)" with
+// op an Int + or *, which wrap around and so are associative and
+// commutative: an accumulator, starting at 0 or 1, collects the x of each
+// level, and what the function would otherwise return is combined with it
+// on the way out.
+//
+//      func fact(n Int) Int {              acc = 1
+//        if n <= 1 { return 1; }     =>    loop: if n <= 1 { return acc * 1; }
+//        return n * fact(n - 1);           acc = acc * n; n = n - 1; goto loop
+//      }
+//
+// Every return of the function must fit: a self call, the same op with a
+// self call, or a value computed without one.
+//
+//////////////////////////////////////////////////////////////////////
+
+static bool is_self_call(const IRInst &inst, const IRFunction &fn)
+{
+  return inst.op == OP_CALL && inst.name == fn.name;
+}
+
+// Assign args to the parameters of fn at the end of bb, all at once: an
+// argument that is another parameter is read before any is written.
+static void assign_params(IRFunction &fn, BasicBlock *bb, const std::vector<Operand> &args)
+{
+  std::vector<Operand> value(args);
+  for (size_t i = 0; i < args.size(); i++)
+  {
+    if (!args[i].is_vreg() || args[i].reg == fn.params[i] ||
+        std::find(fn.params.begin(), fn.params.end(), args[i].reg) == fn.params.end())
+      continue;
+    IRInst save(OP_MOV, fn.vreg_type[args[i].reg]);
+    save.dst = fn.new_vreg(save.type);
+    save.a = args[i];
+    bb->insts.push_back(save);
+    value[i] = Operand::vreg(save.dst);
+  }
+  for (size_t i = 0; i < args.size(); i++)
+  {
+    if (value[i] == Operand::vreg(fn.params[i]))
+      continue;
+    IRInst move(OP_MOV, fn.vreg_type[fn.params[i]]);
+    move.dst = fn.params[i];
+    move.a = value[i];
+    bb->insts.push_back(move);
+  }
+}
+
+void eliminate_tail_recursion(IRFunction &fn)
+{
+  std::vector<BasicBlock *> tail, accumulate, other;
+  Opcode op = OP_MOV;           // of the accumulator, once one is needed
+  bool mixed = false;
+  for (size_t i = 0; i < fn.blocks.size(); i++)
+  {
+    BasicBlock *bb = fn.blocks[i];
+    const std::vector<IRInst> &insts = bb->insts;
+    size_t n = insts.size();
+    const IRInst &ret = insts[n - 1];
+    if (ret.op != OP_RET)
+      continue;
+    if (n >= 2 && is_self_call(insts[n - 2], fn) &&
+        (ret.a.kind == Operand::NONE || ret.a == Operand::vreg(insts[n - 2].dst)))
+    {
+      tail.push_back(bb);
+      continue;
+    }
+    if (n >= 3 && is_self_call(insts[n - 3], fn) && insts[n - 3].dst >= 0)
+    {
+      const IRInst &combine = insts[n - 2];
+      Operand result = Operand::vreg(insts[n - 3].dst);
+      if ((combine.op == OP_ADD || combine.op == OP_MUL) && combine.type == IR_INT &&
+          ret.a == Operand::vreg(combine.dst) && (combine.a == result) != (combine.b == result))
+      {
+        mixed = mixed || (op != OP_MOV && op != combine.op);
+        op = combine.op;
+        accumulate.push_back(bb);
+        continue;
+      }
+    }
+    other.push_back(bb);
+  }
+  if (mixed)
+  {
+    other.insert(other.end(), accumulate.begin(), accumulate.end());
+    accumulate.clear();
+  }
+  if (tail.empty() && accumulate.empty())
+    return;
+
+  BasicBlock *start = fn.blocks[0];
+  BasicBlock *entry = fn.new_block();
+  int acc = -1;
+  if (!accumulate.empty())
+  {
+    IRInst init(OP_MOV, IR_INT);
+    init.dst = acc = fn.new_vreg(IR_INT);
+    init.a = Operand::imm(op == OP_ADD ? 0 : 1);
+    entry->insts.push_back(init);
+  }
+  IRInst enter(OP_JMP);
+  enter.target[0] = start;
+  entry->insts.push_back(enter);
+  fn.blocks.insert(fn.blocks.begin(), entry);
+
+  size_t plain = tail.size();
+  tail.insert(tail.end(), accumulate.begin(), accumulate.end());
+  for (size_t i = 0; i < tail.size(); i++)
+  {
+    std::vector<IRInst> &insts = tail[i]->insts;
+    bool accumulates = i >= plain;
+    size_t at = insts.size() - (accumulates ? 3 : 2);
+    IRInst call = insts[at], combine = insts[at + 1];
+    insts.erase(insts.begin() + at, insts.end());
+    if (accumulates)
+    {
+      IRInst add(op, IR_INT);
+      add.dst = acc;
+      add.a = Operand::vreg(acc);
+      add.b = combine.a == Operand::vreg(call.dst) ? combine.b : combine.a;
+      insts.push_back(add);
+    }
+    assign_params(fn, tail[i], call.args);
+    IRInst loop(OP_JMP);
+    loop.target[0] = start;
+    insts.push_back(loop);
+  }
+  for (size_t i = 0; i < other.size() && acc >= 0; i++)
+  {
+    IRInst &ret = other[i]->terminator();
+    IRInst combine(op, IR_INT);
+    combine.dst = fn.new_vreg(IR_INT);
+    combine.a = Operand::vreg(acc);
+    combine.b = ret.a;
+    ret.a = Operand::vreg(combine.dst);
+    other[i]->insts.insert(other[i]->insts.end() - 1, combine);
+  }
+  fn.compute_cfg();
+}
+
+void optimize_ir(IRFunction &fn)
+{
+  eliminate_tail_recursion(fn);
+  propagate_constants(fn);
+  eliminate_dead_code(fn);
+}
+
+//////////////////////////////////////////////////////////////////////
+//
+// Dominators and natural loops
+//
+// Dominators are computed as in Cooper, Harvey and Kennedy's "A Simple,
+// Fast Dominance Algorithm", over the blocks in reverse postorder.  A
+// natural loop is the set of blocks that reach the source of a back edge,
+// an edge to a block that dominates it, without passing its header; the
+// back edges to one header make one loop.
+//
+//////////////////////////////////////////////////////////////////////
+
+struct Dominators
+{
+  std::vector<BasicBlock *> rpo;        // the blocks in reverse postorder
+  std::vector<int> number;              // by id: the place in rpo, or -1
+  std::vector<BasicBlock *> idom;       // by id; the entry's is itself
+
+  explicit Dominators(IRFunction &fn);
+  bool dominates(BasicBlock *a, BasicBlock *b) const;
+};
+
+Dominators::Dominators(IRFunction &fn)
+{
+  size_t nblocks = fn.all_blocks.size();
+  number.assign(nblocks, -1);
+  idom.assign(nblocks, NULL);
+
+  // postorder, by an explicit stack of (block, next successor)
+  std::vector<bool> seen(nblocks, false);
+  std::vector<std::pair<BasicBlock *, size_t> > stack;
+  stack.push_back(std::make_pair(fn.blocks[0], 0));
+  seen[fn.blocks[0]->id] = true;
+  while (!stack.empty())
+  {
+    BasicBlock *bb = stack.back().first;
+    size_t k = stack.back().second++;
+    if (k < bb->succs.size())
+    {
+      BasicBlock *succ = bb->succs[k];
+      if (!seen[succ->id])
+      {
+        seen[succ->id] = true;
+        stack.push_back(std::make_pair(succ, 0));
+      }
+      continue;
+    }
+    rpo.push_back(bb);
+    stack.pop_back();
+  }
+  std::reverse(rpo.begin(), rpo.end());
+  for (size_t i = 0; i < rpo.size(); i++)
+    number[rpo[i]->id] = i;
+
+  idom[rpo[0]->id] = rpo[0];
+  for (bool changed = true; changed;)
+  {
+    changed = false;
+    for (size_t i = 1; i < rpo.size(); i++)
+    {
+      BasicBlock *bb = rpo[i], *new_idom = NULL;
+      for (size_t k = 0; k < bb->preds.size(); k++)
+      {
+        BasicBlock *p = bb->preds[k];
+        if (idom[p->id] == NULL)
+          continue;
+        if (new_idom == NULL)
+        {
+          new_idom = p;
+          continue;
+        }
+        // intersect
+        while (p != new_idom)
+        {
+          while (number[p->id] > number[new_idom->id])
+            p = idom[p->id];
+          while (number[new_idom->id] > number[p->id])
+            new_idom = idom[new_idom->id];
+        }
+      }
+      if (idom[bb->id] != new_idom)
+      {
+        idom[bb->id] = new_idom;
+        changed = true;
+      }
+    }
+  }
+}
+
+bool Dominators::dominates(BasicBlock *a, BasicBlock *b) const
+{
+  for (;;)
+  {
+    if (a == b)
+      return true;
+    if (idom[b->id] == b)
+      return false;
+    b = idom[b->id];
+  }
+}
+
+struct Loop
+{
+  BasicBlock *header;
+  std::set<BasicBlock *> body;          // the header included
+  BasicBlock *preheader;
+
+  bool contains(BasicBlock *bb) const { return body.count(bb) != 0; }
+};
+
+static bool smaller_loop(const Loop &x, const Loop &y)
+{
+  return x.body.size() < y.body.size();
+}
+
+// The natural loops of fn, inner loops before the loops around them.
+static void find_loops(IRFunction &fn, const Dominators &dom, std::vector<Loop> &loops)
+{
+  std::map<BasicBlock *, size_t> of_header;
+  for (size_t i = 0; i < dom.rpo.size(); i++)
+  {
+    BasicBlock *bb = dom.rpo[i];
+    for (size_t k = 0; k < bb->succs.size(); k++)
+    {
+      BasicBlock *header = bb->succs[k];
+      if (!dom.dominates(header, bb))
+        continue;
+      if (!of_header.count(header))
+      {
+        of_header[header] = loops.size();
+        Loop loop;
+        loop.header = header;
+        loop.body.insert(header);
+        loop.preheader = NULL;
+        loops.push_back(loop);
+      }
+      Loop &loop = loops[of_header[header]];
+      std::vector<BasicBlock *> work;
+      if (loop.body.insert(bb).second)
+        work.push_back(bb);
+      while (!work.empty())
+      {
+        BasicBlock *n = work.back();
+        work.pop_back();
+        for (size_t p = 0; p < n->preds.size(); p++)
+          if (loop.body.insert(n->preds[p]).second)
+            work.push_back(n->preds[p]);
+      }
+    }
+  }
+  std::stable_sort(loops.begin(), loops.end(), smaller_loop);
+}
+
+//
+// Give the loop a preheader: a block of its own that the edges entering
+// the header from outside the loop now go through, laid out right before
+// the header.  Left empty, compute_cfg threads jumps through it again.
+//
+static void add_preheader(IRFunction &fn, Loop &loop, std::vector<Loop> &loops)
+{
+  BasicBlock *header = loop.header;
+  BasicBlock *pre = fn.new_block();
+  IRInst jump(OP_JMP);
+  jump.target[0] = header;
+  pre->insts.push_back(jump);
+
+  std::vector<BasicBlock *> inner_preds;
+  for (size_t k = 0; k < header->preds.size(); k++)
+  {
+    BasicBlock *p = header->preds[k];
+    if (loop.contains(p))
+    {
+      inner_preds.push_back(p);
+      continue;
+    }
+    IRInst &term = p->terminator();
+    for (int t = 0; t < 2; t++)
+      if (term.target[t] == header)
+        term.target[t] = pre;
+    std::replace(p->succs.begin(), p->succs.end(), header, pre);
+    pre->preds.push_back(p);
+  }
+  inner_preds.push_back(pre);
+  header->preds.swap(inner_preds);
+  pre->succs.push_back(header);
+  fn.blocks.insert(std::find(fn.blocks.begin(), fn.blocks.end(), header), pre);
+
+  loop.preheader = pre;
+  for (size_t i = 0; i < loops.size(); i++)
+    if (&loops[i] != &loop && loops[i].header != header && loops[i].contains(header))
+      loops[i].body.insert(pre);
+}
+
+//////////////////////////////////////////////////////////////////////
+//
+// Function effects
+//
+// A function is pure if its result depends on its arguments alone: it
+// reads and writes no global and calls only pure functions, which makes
+// recursion pure unless something else spoils it.  Functions outside the
+// program, printf and the like, are not pure, but cannot write the
+// program's globals either.
+//
+//////////////////////////////////////////////////////////////////////
+
+void summarize_effects(const std::vector<IRFunction *> &fns, EffectSummary &effects)
+{
+  for (size_t f = 0; f < fns.size(); f++)
+  {
+    effects[fns[f]->name].pure = true;
+    effects[fns[f]->name].writes_globals = false;
+  }
+  for (bool changed = true; changed;)
+  {
+    changed = false;
+    for (size_t f = 0; f < fns.size(); f++)
+    {
+      FunctionEffects &e = effects[fns[f]->name];
+      bool pure = true, writes = false;
+      for (size_t i = 0; i < fns[f]->blocks.size(); i++)
+        for (size_t k = 0; k < fns[f]->blocks[i]->insts.size(); k++)
+        {
+          const IRInst &inst = fns[f]->blocks[i]->insts[k];
+          if (inst.op == OP_LOAD)
+            pure = false;
+          else if (inst.op == OP_STORE)
+            pure = false, writes = true;
+          else if (inst.op == OP_CALL)
+          {
+            EffectSummary::const_iterator callee = effects.find(inst.name);
+            if (callee == effects.end())
+              pure = false;
+            else
+            {
+              pure = pure && callee->second.pure;
+              writes = writes || callee->second.writes_globals;
+            }
+          }
+        }
+      if (pure != e.pure || writes != e.writes_globals)
+      {
+        e.pure = pure;
+        e.writes_globals = writes;
+        changed = true;
+      }
+    }
+  }
+}
+
+//////////////////////////////////////////////////////////////////////
+//
+// Loop-invariant code motion
+//
+// An instruction of a loop moves to the loop's preheader when it computes
+// the same value on every iteration and nothing else notices the move:
+//
+//   - it has no effect besides writing its dst, or is a call to a pure
+//     function; a load of a global counts if the loop neither stores to
+//     it nor calls a function that may;
+//   - none of the vregs it reads is written in the loop;
+//   - it is the only instruction of the loop writing its dst, and no use
+//     in the loop sees an earlier value: the dst is dead at the header;
+//   - the dst is dead where the loop exits, or the instruction runs on
+//     every way out of the loop, so it ran at least once there anyway.
+//
+// What may trap or take long, a division by a variable or a call, moves
+// only under the last condition, so that it runs only if it would have.
+// Inner loops go first, so what they hoist can move on out of the loops
+// around them.
+//
+//////////////////////////////////////////////////////////////////////
+
+static void hoist_invariants(IRFunction &fn, Loop &loop, const Dominators &dom,
+                             const IRLiveness &liveness, const EffectSummary &effects)
+{
+  // in reverse postorder, so that a definition moves before its uses
+  std::vector<BasicBlock *> blocks, exits, exiting;
+  for (size_t i = 0; i < dom.rpo.size(); i++)
+    if (loop.contains(dom.rpo[i]))
+      blocks.push_back(dom.rpo[i]);
+  for (size_t i = 0; i < blocks.size(); i++)
+    for (size_t k = 0; k < blocks[i]->succs.size(); k++)
+      if (!loop.contains(blocks[i]->succs[k]))
+      {
+        exits.push_back(blocks[i]->succs[k]);
+        exiting.push_back(blocks[i]);
+      }
+
+  std::vector<int> defs(fn.vreg_type.size(), 0);
+  std::set<Symbol> stored;
+  bool writes_globals = false;
+  for (size_t i = 0; i < blocks.size(); i++)
+    for (size_t k = 0; k < blocks[i]->insts.size(); k++)
+    {
+      const IRInst &inst = blocks[i]->insts[k];
+      if (inst.dst >= 0)
+        defs[inst.dst]++;
+      if (inst.op == OP_STORE)
+        stored.insert(inst.name);
+      if (inst.op == OP_CALL)
+      {
+        EffectSummary::const_iterator callee = effects.find(inst.name);
+        writes_globals = writes_globals ||
+                         (callee != effects.end() && callee->second.writes_globals);
+      }
+    }
+
+  std::vector<IRInst> &pre = loop.preheader->insts;
+  for (size_t i = 0; i < blocks.size(); i++)
+  {
+    BasicBlock *bb = blocks[i];
+    bool every_exit = true;
+    for (size_t k = 0; k < exiting.size() && every_exit; k++)
+      every_exit = dom.dominates(bb, exiting[k]);
+
+    std::vector<IRInst> kept;
+    for (size_t k = 0; k < bb->insts.size(); k++)
+    {
+      const IRInst &inst = bb->insts[k];
+      bool movable, safe;
+      if (inst.op == OP_CALL)
+      {
+        EffectSummary::const_iterator callee = effects.find(inst.name);
+        movable = callee != effects.end() && callee->second.pure;
+        safe = false;
+      }
+      else if (inst.op == OP_LOAD)
+      {
+        movable = !writes_globals && !stored.count(inst.name);
+        safe = true;
+      }
+      else
+      {
+        movable = !inst.is_terminator() && inst.op != OP_STORE;
+        safe = !has_side_effects(inst);
+      }
+      movable = movable && inst.dst >= 0 && defs[inst.dst] == 1 &&
+                !liveness.live_in[loop.header->id].has(inst.dst);
+
+      std::vector<int> read;
+      inst.uses(read);
+      for (size_t r = 0; r < read.size() && movable; r++)
+        movable = defs[read[r]] == 0;
+      for (size_t e = 0; e < exits.size() && movable && !every_exit; e++)
+        movable = !liveness.live_in[exits[e]->id].has(inst.dst);
+      if (movable && !safe)
+        movable = every_exit;
+
+      if (!movable)
+      {
+        kept.push_back(inst);
+        continue;
+      }
+      defs[inst.dst] = 0;
+      pre.insert(pre.end() - 1, inst);
+    }
+    bb->insts.swap(kept);
+  }
+}
+
+void hoist_loop_invariants(IRFunction &fn, const EffectSummary &effects)
+{
+  std::vector<Loop> loops;
+  {
+    Dominators dom(fn);
+    find_loops(fn, dom, loops);
+  }
+  if (loops.empty())
+    return;
+  for (size_t i = 0; i < loops.size(); i++)
+    add_preheader(fn, loops[i], loops);
+
+  Dominators dom(fn);
+  IRLiveness liveness(fn);
+  for (size_t i = 0; i < loops.size(); i++)
+    hoist_invariants(fn, loops[i], dom, liveness, effects);
+  fn.compute_cfg();
+}
+
+//////////////////////////////////////////////////////////////////////
+//
+// Loop rotation
+//
+// A loop is lowered with its test at the top and a jump back to it at the
+// bottom, so every iteration runs a jmp and a conditional branch.  The
+// test is copied to the bottom instead, to a block that the jumps back
+// now go to, and the test at the top is left as a guard that runs once:
+//
+//      H: test; if c goto B else E         H: test; if c goto B else E
+//      B: ...                       =>     B: ...
+//         jmp H                            T: test; if c goto B else E
+//      E:                                  E:
+//
+// Vregs may be written more than once, so the copy is the same code.  The
+// loop is then headed by B, and its blocks dominate the way out through T,
+// which lets loop-invariant code motion move calls and divisions too.
+//
+//////////////////////////////////////////////////////////////////////
+
+static const size_t ROTATE_LIMIT = 8;   // the most instructions copied
+
+// Can the loop be rotated?  Its header must be a short test that either
+// stays in the loop or leaves it, and not at the bottom already.
+static bool rotatable(const Loop &loop)
+{
+  BasicBlock *header = loop.header;
+  const IRInst &term = header->terminator();
+  if (term.op != OP_CBR || header->insts.size() > ROTATE_LIMIT)
+    return false;
+  bool in0 = loop.contains(term.target[0]), in1 = loop.contains(term.target[1]);
+  return in0 != in1 && term.target[in0 ? 0 : 1] != header;
+}
+
+void rotate_loops(IRFunction &fn)
+{
+  std::set<BasicBlock *> done;
+  for (;;)
+  {
+    Dominators dom(fn);
+    std::vector<Loop> loops;
+    find_loops(fn, dom, loops);
+    const Loop *loop = NULL;
+    for (size_t i = 0; i < loops.size() && loop == NULL; i++)
+      if (!done.count(loops[i].header) && rotatable(loops[i]))
+        loop = &loops[i];
+    if (loop == NULL)
+      return;
+
+    BasicBlock *header = loop->header;
+    const IRInst &term = header->terminator();
+    BasicBlock *test = fn.new_block();
+    test->insts = header->insts;
+    for (size_t k = 0; k < header->preds.size(); k++)
+    {
+      if (!loop->contains(header->preds[k]))
+        continue;
+      IRInst &back = header->preds[k]->terminator();
+      for (int t = 0; t < 2; t++)
+        if (back.target[t] == header)
+          back.target[t] = test;
+    }
+    // after the last block of the loop
+    size_t last = 0;
+    for (size_t i = 0; i < fn.blocks.size(); i++)
+      if (loop->contains(fn.blocks[i]))
+        last = i;
+    fn.blocks.insert(fn.blocks.begin() + last + 1, test);
+
+    done.insert(header);
+    done.insert(term.target[loop->contains(term.target[0]) ? 0 : 1]);
+    fn.compute_cfg();
+  }
+}
+
+//////////////////////////////////////////////////////////////////////
+//
+// Value numbering
+//
+// Each value computed gets a number, the same for two instructions doing
+// the same operation on values with the same numbers, so that the second
+// can take the first one's result instead: an expression written twice,
+// a global loaded again or loaded right after a store to it, a pure
+// function called again with the same arguments.  The blocks are visited
+// down the dominator tree, and what a block computes stays available in
+// the blocks it dominates; within a block this is local value numbering.
+//
+// The IR is not in SSA form, so a vreg is numbered by the value it holds
+// where the walk is.  A vreg written once, before anything reads it, holds
+// the same value everywhere it is read ("stable").  Any other vreg, and
+// every global, is given a new number at the start of a block with more
+// than one pred, since it may have been assigned on the way.  A value is
+// taken only from a constant or a vreg that still holds it.
+//
+//////////////////////////////////////////////////////////////////////
+
+// An operation on numbered values.
+struct Expression
+{
+  Opcode op;
+  IRType type;
+  Relation rel;
+  Symbol name;                  // OP_LOAD, OP_CALL
+  std::vector<int> values;      // the operands'; the global's for OP_LOAD
+
+  bool operator<(const Expression &e) const
+  {
+    if (op != e.op)
+      return op < e.op;
+    if (type != e.type)
+      return type < e.type;
+    if (rel != e.rel)
+      return rel < e.rel;
+    if (name != e.name)
+      return name < e.name;
+    return values < e.values;
+  }
+};
+
+// What is known at a point of the walk.
+struct ValueState
+{
+  std::vector<int> value;                       // by vreg, or -1 if not yet
+  std::map<Symbol, int> contents;               // by global
+  std::map<Expression, int> computed;
+  std::map<int, int> holder;                    // by number: a vreg with it
+};
+
+struct ValueNumbering
+{
+  IRFunction &fn;
+  const EffectSummary &effects;
+  std::vector<bool> stable;                     // by vreg
+  std::map<std::pair<int, long long>, int> constants;
+  std::map<int, Operand> constant_of;           // by number
+  int next;
+
+  ValueNumbering(IRFunction &f, const EffectSummary &e);
+  int number(const Operand &o, ValueState &state);
+  Operand available(int n, const ValueState &state);
+  void assign(int dst, int n, ValueState &state);
+  void visit(IRInst &inst, ValueState &state);
+};
+
+ValueNumbering::ValueNumbering(IRFunction &f, const EffectSummary &e)
+    : fn(f), effects(e), next(0)
+{
+  std::vector<int> defs(fn.vreg_type.size(), 0);
+  for (size_t i = 0; i < fn.params.size(); i++)
+    defs[fn.params[i]]++;
+  for (size_t i = 0; i < fn.blocks.size(); i++)
+    for (size_t k = 0; k < fn.blocks[i]->insts.size(); k++)
+      if (fn.blocks[i]->insts[k].dst >= 0)
+        defs[fn.blocks[i]->insts[k].dst]++;
+  IRLiveness liveness(fn);
+  const VregSet &on_entry = liveness.live_in[fn.blocks[0]->id];
+  stable.assign(fn.vreg_type.size(), false);
+  for (size_t v = 0; v < stable.size(); v++)
+    stable[v] = defs[v] == 1 && !on_entry.has(v);
+  for (size_t i = 0; i < fn.params.size(); i++)
+    stable[fn.params[i]] = defs[fn.params[i]] == 1;
+}
+
+int ValueNumbering::number(const Operand &o, ValueState &state)
+{
+  if (o.is_vreg())
+  {
+    if (state.value[o.reg] < 0)
+      assign(o.reg, next++, state);
+    return state.value[o.reg];
+  }
+  std::pair<int, long long> key(o.kind, o.ival);
+  if (o.kind == Operand::FLOAT)
+    memcpy(&key.second, &o.fval, sizeof(key.second));
+  else if (o.kind == Operand::STRING)
+    key.second = (long long)(size_t)o.sym;
+  std::map<std::pair<int, long long>, int>::iterator it = constants.find(key);
+  if (it != constants.end())
+    return it->second;
+  constants[key] = next;
+  constant_of[next] = o;
+  return next++;
+}
+
+// A constant or vreg holding value n here, or NONE.
+Operand ValueNumbering::available(int n, const ValueState &state)
+{
+  std::map<int, Operand>::const_iterator c = constant_of.find(n);
+  if (c != constant_of.end())
+    return c->second;
+  std::map<int, int>::const_iterator h = state.holder.find(n);
+  if (h != state.holder.end() && state.value[h->second] == n)
+    return Operand::vreg(h->second);
+  return Operand();
+}
+
+void ValueNumbering::assign(int dst, int n, ValueState &state)
+{
+  state.value[dst] = n;
+  Operand held = available(n, state);
+  if (held.kind == Operand::NONE || (held.is_vreg() && !stable[held.reg] && stable[dst]))
+    state.holder[n] = dst;
+}
+
+// Reuse what inst computes if it is available, and record what it does.
+void ValueNumbering::visit(IRInst &inst, ValueState &state)
+{
+  Operand *operands[] = {&inst.a, &inst.b};
+  for (int i = 0; i < 2 + (int)inst.args.size(); i++)
+  {
+    Operand &o = i < 2 ? *operands[i] : inst.args[i - 2];
+    if (!o.is_vreg())
+      continue;
+    Operand held = available(number(o, state), state);
+    if (held.is_const() || (held.is_vreg() && stable[held.reg]))
+      o = held;
+  }
+
+  bool pure_call = false;
+  if (inst.op == OP_CALL)
+  {
+    EffectSummary::const_iterator callee = effects.find(inst.name);
+    pure_call = callee != effects.end() && callee->second.pure;
+    if (callee != effects.end() && callee->second.writes_globals)
+      state.contents.clear();
+  }
+  if (inst.op == OP_STORE)
+  {
+    int contents = next++;
+    state.contents[inst.name] = contents;
+    Expression load = {OP_LOAD, IR_VOID, REL_EQ, inst.name, std::vector<int>(1, contents)};
+    state.computed[load] = number(inst.a, state);
+    return;
+  }
+  if (inst.dst < 0)
+    return;
+  if (inst.op == OP_MOV)
+  {
+    assign(inst.dst, number(inst.a, state), state);
+    return;
+  }
+  if (inst.op == OP_CALL && !pure_call)
+  {
+    assign(inst.dst, next++, state);
+    return;
+  }
+
+  Expression e = {inst.op, inst.type, inst.rel, inst.name, std::vector<int>()};
+  if (inst.op == OP_LOAD)
+  {
+    e.type = IR_VOID;           // the global's, whatever stored to it
+    if (!state.contents.count(inst.name))
+      state.contents[inst.name] = next++;
+    e.values.push_back(state.contents[inst.name]);
+  }
+  if (inst.a.kind != Operand::NONE)
+    e.values.push_back(number(inst.a, state));
+  if (inst.b.kind != Operand::NONE)
+    e.values.push_back(number(inst.b, state));
+  for (size_t n = 0; n < inst.args.size(); n++)
+    e.values.push_back(number(inst.args[n], state));
+  if (inst.op == OP_ADD || inst.op == OP_MUL || inst.op == OP_AND ||
+      inst.op == OP_OR || inst.op == OP_XOR)
+    std::sort(e.values.begin(), e.values.end());
+  if (inst.op != OP_CMP && inst.op != OP_SELECT && inst.op != OP_CALL)
+    e.rel = REL_EQ;
+
+  std::map<Expression, int>::iterator found = state.computed.find(e);
+  if (found == state.computed.end())
+  {
+    int n = next++;
+    state.computed[e] = n;
+    assign(inst.dst, n, state);
+    return;
+  }
+  Operand held = available(found->second, state);
+  if (held.kind != Operand::NONE)
+  {
+    IRInst move(OP_MOV, fn.vreg_type[inst.dst]);
+    move.dst = inst.dst;
+    move.a = held;
+    inst = move;
+  }
+  assign(inst.dst, found->second, state);
+}
+
+void number_values(IRFunction &fn, const EffectSummary &effects)
+{
+  Dominators dom(fn);
+  std::vector<std::vector<BasicBlock *> > children(fn.all_blocks.size());
+  for (size_t i = 1; i < dom.rpo.size(); i++)
+    children[dom.idom[dom.rpo[i]->id]->id].push_back(dom.rpo[i]);
+
+  ValueNumbering numbering(fn, effects);
+  ValueState start;
+  start.value.assign(fn.vreg_type.size(), -1);
+  std::vector<std::pair<BasicBlock *, ValueState> > work;
+  work.push_back(std::make_pair(fn.blocks[0], start));
+  while (!work.empty())
+  {
+    BasicBlock *bb = work.back().first;
+    ValueState state;
+    std::swap(state, work.back().second);
+    work.pop_back();
+    // Reached other than from the dominator, things may have changed.
+    if (bb->preds.size() > 1)
+    {
+      for (size_t v = 0; v < state.value.size(); v++)
+        if (!numbering.stable[v])
+          state.value[v] = -1;
+      state.contents.clear();
+    }
+    for (size_t k = 0; k < bb->insts.size(); k++)
+      numbering.visit(bb->insts[k], state);
+    const std::vector<BasicBlock *> &below = children[bb->id];
+    for (size_t c = 0; c < below.size(); c++)
+      work.push_back(std::make_pair(below[c], state));
+  }
+}
+
+//////////////////////////////////////////////////////////////////////
+//
+// If-conversion
+//
+// A branch whose arms each only assign the same vreg and meet again, or
+// with one arm doing so and the other empty, is often mispredicted when
+// the test depends on the data, and costs a jump besides:
+//
+//      B: if c goto T else F               B: t = v
+//      T: x = v; goto J            =>         x = c ? t : w
+//      F: x = w; goto J                       goto J
+//
+// Both values are computed ahead of the test, so only cheap instructions
+// with no other effect qualify.  A Float has no cmov and is left alone.
+//
+//////////////////////////////////////////////////////////////////////
+
+// The instruction of the arm bb of a branch from from, if it is the only
+// one besides the jump on and could run whether bb does or not.
+static const IRInst *lone_assignment(const IRFunction &fn, BasicBlock *bb, BasicBlock *from)
+{
+  if (bb->preds.size() != 1 || bb->preds[0] != from || bb->insts.size() != 2 ||
+      bb->terminator().op != OP_JMP)
+    return NULL;
+  const IRInst &inst = bb->insts[0];
+  if (inst.dst < 0 || fn.vreg_type[inst.dst] == IR_FLOAT || has_side_effects(inst) ||
+      inst.op == OP_DIV || inst.op == OP_MOD || inst.op == OP_SELECT)
+    return NULL;
+  return &inst;
+}
+
+// What dst holds once inst ran, computed at the end of bb; dst itself if
+// there is no inst.
+static Operand speculate(IRFunction &fn, BasicBlock *bb, const IRInst *inst, int dst)
+{
+  if (inst == NULL)
+    return Operand::vreg(dst);
+  if (inst->op == OP_MOV)
+    return inst->a;
+  IRInst early(*inst);
+  early.dst = fn.new_vreg(fn.vreg_type[dst]);
+  bb->insts.insert(bb->insts.end() - 1, early);
+  return Operand::vreg(early.dst);
+}
+
+bool if_convert(IRFunction &fn)
+{
+  bool changed = false;
+  for (size_t i = 0; i < fn.blocks.size(); i++)
+  {
+    BasicBlock *bb = fn.blocks[i];
+    IRInst branch = bb->terminator();
+    if (branch.op != OP_CBR || branch.target[0] == branch.target[1])
+      continue;
+    BasicBlock *t = branch.target[0], *f = branch.target[1];
+    const IRInst *on_true = lone_assignment(fn, t, bb);
+    const IRInst *on_false = lone_assignment(fn, f, bb);
+    BasicBlock *join;
+    if (on_true != NULL && on_false != NULL && on_true->dst == on_false->dst &&
+        t->terminator().target[0] == f->terminator().target[0])
+      join = t->terminator().target[0];
+    else if (on_true != NULL && t->terminator().target[0] == f)
+    {
+      join = f;
+      on_false = NULL;
+    }
+    else if (on_false != NULL && f->terminator().target[0] == t)
+    {
+      join = t;
+      on_true = NULL;
+    }
+    else
+    {
+      continue;
+    }
+
+    int dst = (on_true != NULL ? on_true : on_false)->dst;
+    IRInst select(OP_SELECT, branch.type);
+    select.rel = branch.rel;
+    select.dst = dst;
+    select.a = branch.a;
+    select.b = branch.b;
+    select.args.push_back(speculate(fn, bb, on_true, dst));
+    select.args.push_back(speculate(fn, bb, on_false, dst));
+    IRInst jump(OP_JMP);
+    jump.target[0] = join;
+    bb->insts.back() = select;
+    bb->insts.push_back(jump);
+    changed = true;
+  }
+  if (changed)
+    fn.compute_cfg();
+  return changed;
+}
+
+//////////////////////////////////////////////////////////////////////
+//
+// Cold blocks
+//
+// Without a profile, some branches are still predicted well by static
+// rules (Ball and Larus, "Branch Prediction for Free"): a branch inside a
+// loop is unlikely to leave it, and an arm that calls outside the program,
+// say to print an error, and returns at once is unlikely to be taken.
+// Such an arm, with everything only it leads to, is moved to the end of
+// the function, so the likely path falls through and stays together.
+// Loop headers are marked to start on a fresh fetch block.
+//
+//////////////////////////////////////////////////////////////////////
+
+// Is the arm bb of a branch from a block of loop (if any) unlikely?
+static bool is_cold(BasicBlock *bb, BasicBlock *other, const Loop *loop,
+                    const EffectSummary &effects)
+{
+  if (bb->preds.size() != 1)
+    return false;
+  if (loop != NULL && !loop->contains(bb) && loop->contains(other))
+    return true;
+  if (bb->terminator().op != OP_RET || other->terminator().op == OP_RET)
+    return false;
+  for (size_t k = 0; k < bb->insts.size(); k++)
+    if (bb->insts[k].op == OP_CALL && !effects.count(bb->insts[k].name))
+      return true;
+  return false;
+}
+
+void lay_out_blocks(IRFunction &fn, const EffectSummary &effects)
+{
+  Dominators dom(fn);
+  std::vector<Loop> loops;
+  find_loops(fn, dom, loops);
+  for (size_t l = 0; l < loops.size(); l++)
+    loops[l].header->align = true;
+
+  std::vector<BasicBlock *> cold_heads;
+  for (size_t i = 0; i < fn.blocks.size(); i++)
+  {
+    BasicBlock *bb = fn.blocks[i];
+    const IRInst &term = bb->terminator();
+    if (term.op != OP_CBR)
+      continue;
+    // The test at the bottom of a loop is not a branch out of it.
+    const Loop *loop = NULL;
+    for (size_t l = 0; l < loops.size() && loop == NULL; l++)
+      if (loops[l].contains(bb))
+        loop = &loops[l];
+    if (loop != NULL && (term.target[0] == loop->header || term.target[1] == loop->header))
+      continue;
+    for (int t = 0; t < 2; t++)
+      if (is_cold(term.target[t], term.target[1 - t], loop, effects))
+        cold_heads.push_back(term.target[t]);
+  }
+  if (cold_heads.empty())
+    return;
+
+  std::vector<BasicBlock *> hot, cold;
+  for (size_t i = 0; i < fn.blocks.size(); i++)
+  {
+    bool in_cold = false;
+    for (size_t c = 0; c < cold_heads.size() && !in_cold; c++)
+      in_cold = dom.dominates(cold_heads[c], fn.blocks[i]);
+    (in_cold ? cold : hot).push_back(fn.blocks[i]);
+  }
+  fn.blocks.swap(hot);
+  fn.blocks.insert(fn.blocks.end(), cold.begin(), cold.end());
+}
+
+//////////////////////////////////////////////////////////////////////
+//
+// Inlining
+//
+// A call is replaced by a copy of the callee when the callee is small: at
+// most inline_limit instructions (-inline-limit=N), or four times that
+// if this is the only call to it anywhere, so that the callee goes away
+// and the code does not grow.  Callers stop taking callees in once they
+// have grown past MAX_CALLER_SIZE instructions.
+//
+// The copy gets vregs and blocks of its own: the parameters become vregs
+// the arguments are moved to, and every return a move to the call's dst
+// and a jump to the rest of the caller.  Functions are visited callees
+// first, along the call graph, so a callee has had its own calls inlined
+// by the time it is copied.  Within a cycle of recursive functions a call
+// is copied once, from the callee as it was before this round, so that
+// recursion is unrolled by one level and no further.
+//
+//////////////////////////////////////////////////////////////////////
+
+static const size_t MAX_CALLER_SIZE = 2000;
+
+static size_t function_size(const IRFunction &fn)
+{
+  size_t size = 0;
+  for (size_t i = 0; i < fn.blocks.size(); i++)
+    size += fn.blocks[i]->insts.size();
+  return size;
+}
+
+//
+// The strongly connected components of the call graph, by Tarjan's
+// algorithm, in the order it finds them: a component comes after every
+// component it calls into.  component[name] is the index of its own.
+//
+struct CallGraph
+{
+  std::map<Symbol, IRFunction *> by_name;
+  std::map<Symbol, std::vector<IRFunction *> > callees;
+  std::vector<std::vector<IRFunction *> > components;
+  std::map<Symbol, size_t> component;
+  std::map<Symbol, int> calls_to;       // call sites, over the program
+
+  explicit CallGraph(const std::vector<IRFunction *> &fns);
+
+private:
+  std::map<Symbol, int> index, low;
+  std::vector<IRFunction *> stack;
+  std::set<Symbol> on_stack;
+  void visit(IRFunction *fn);
+};
+
+CallGraph::CallGraph(const std::vector<IRFunction *> &fns)
+{
+  for (size_t f = 0; f < fns.size(); f++)
+    by_name[fns[f]->name] = fns[f];
+  for (size_t f = 0; f < fns.size(); f++)
+  {
+    std::vector<IRFunction *> &out = callees[fns[f]->name];
+    for (size_t i = 0; i < fns[f]->blocks.size(); i++)
+      for (size_t k = 0; k < fns[f]->blocks[i]->insts.size(); k++)
+      {
+        const IRInst &inst = fns[f]->blocks[i]->insts[k];
+        if (inst.op != OP_CALL || !by_name.count(inst.name))
+          continue;
+        calls_to[inst.name]++;
+        if (std::find(out.begin(), out.end(), by_name[inst.name]) == out.end())
+          out.push_back(by_name[inst.name]);
+      }
+  }
+  for (size_t f = 0; f < fns.size(); f++)
+    if (!index.count(fns[f]->name))
+      visit(fns[f]);
+}
+
+void CallGraph::visit(IRFunction *fn)
+{
+  int n = index.size();
+  index[fn->name] = low[fn->name] = n;
+  stack.push_back(fn);
+  on_stack.insert(fn->name);
+  const std::vector<IRFunction *> &out = callees[fn->name];
+  for (size_t k = 0; k < out.size(); k++)
+  {
+    Symbol callee = out[k]->name;
+    if (!index.count(callee))
+    {
+      visit(out[k]);
+      low[fn->name] = std::min(low[fn->name], low[callee]);
+    }
+    else if (on_stack.count(callee))
+      low[fn->name] = std::min(low[fn->name], index[callee]);
+  }
+  if (low[fn->name] != index[fn->name])
+    return;
+  std::vector<IRFunction *> members;
+  IRFunction *member;
+  do
+  {
+    member = stack.back();
+    stack.pop_back();
+    on_stack.erase(member->name);
+    component[member->name] = components.size();
+    members.push_back(member);
+  } while (member != fn);
+  components.push_back(members);
+}
+
+//
+// A copy of callee, laid out in place of the call at index k of bb, a
+// block of fn.  What follows the call moves to a block of its own, which
+// is returned.
+//
+static BasicBlock *inline_call(IRFunction &fn, BasicBlock *bb, size_t k, const IRFunction &callee)
+{
+  IRInst call = bb->insts[k];
+  BasicBlock *rest = fn.new_block();
+  rest->insts.assign(bb->insts.begin() + k + 1, bb->insts.end());
+  bb->insts.erase(bb->insts.begin() + k, bb->insts.end());
+
+  std::vector<int> vreg(callee.vreg_type.size());
+  for (size_t v = 0; v < vreg.size(); v++)
+    vreg[v] = fn.new_vreg(callee.vreg_type[v], callee.vreg_name[v]);
+  std::map<BasicBlock *, BasicBlock *> block;
+  for (size_t i = 0; i < callee.blocks.size(); i++)
+    block[callee.blocks[i]] = fn.new_block();
+
+  for (size_t n = 0; n < callee.params.size(); n++)
+  {
+    IRInst move(OP_MOV, callee.vreg_type[callee.params[n]]);
+    move.dst = vreg[callee.params[n]];
+    move.a = call.args[n];
+    bb->insts.push_back(move);
+  }
+  IRInst enter(OP_JMP);
+  enter.target[0] = block[callee.blocks[0]];
+  bb->insts.push_back(enter);
+
+  std::vector<BasicBlock *> copies;
+  for (size_t i = 0; i < callee.blocks.size(); i++)
+  {
+    BasicBlock *copy = block[callee.blocks[i]];
+    copies.push_back(copy);
+    const std::vector<IRInst> &insts = callee.blocks[i]->insts;
+    for (size_t j = 0; j < insts.size(); j++)
+    {
+      IRInst inst = insts[j];
+      if (inst.dst >= 0)
+        inst.dst = vreg[inst.dst];
+      Operand *ops[2] = { &inst.a, &inst.b };
+      for (int o = 0; o < 2; o++)
+        if (ops[o]->is_vreg())
+          *ops[o] = Operand::vreg(vreg[ops[o]->reg]);
+      for (size_t n = 0; n < inst.args.size(); n++)
+        if (inst.args[n].is_vreg())
+          inst.args[n] = Operand::vreg(vreg[inst.args[n].reg]);
+      for (int t = 0; t < 2; t++)
+        if (inst.target[t] != NULL)
+          inst.target[t] = block[inst.target[t]];
+
+      if (inst.op == OP_RET)
+      {
+        if (call.dst >= 0 && inst.a.kind != Operand::NONE)
+        {
+          IRInst move(OP_MOV, fn.vreg_type[call.dst]);
+          move.dst = call.dst;
+          move.a = inst.a;
+          copy->insts.push_back(move);
+        }
+        inst = IRInst(OP_JMP);
+        inst.target[0] = rest;
+      }
+      copy->insts.push_back(inst);
+    }
+  }
+  copies.push_back(rest);
+  std::vector<BasicBlock *>::iterator at = std::find(fn.blocks.begin(), fn.blocks.end(), bb);
+  fn.blocks.insert(at + 1, copies.begin(), copies.end());
+  return rest;
+}
+
+//
+// Make a copy of fn that owns its blocks, for inlining from while fn
+// itself changes.
+//
+static IRFunction *snapshot(const IRFunction &fn)
+{
+  IRFunction *copy = new IRFunction(fn.name, fn.ret_type);
+  copy->vreg_type = fn.vreg_type;
+  copy->vreg_name = fn.vreg_name;
+  copy->params = fn.params;
+  std::map<BasicBlock *, BasicBlock *> block;
+  for (size_t i = 0; i < fn.blocks.size(); i++)
+  {
+    block[fn.blocks[i]] = copy->new_block();
+    copy->blocks.push_back(block[fn.blocks[i]]);
+  }
+  for (size_t i = 0; i < fn.blocks.size(); i++)
+  {
+    BasicBlock *bb = block[fn.blocks[i]];
+    bb->insts = fn.blocks[i]->insts;
+    IRInst &term = bb->terminator();
+    for (int t = 0; t < 2; t++)
+      if (term.target[t] != NULL)
+        term.target[t] = block[term.target[t]];
+  }
+  return copy;
+}
+
+void inline_calls(std::vector<IRFunction *> &fns)
+{
+  if (inline_limit <= 0)
+    return;
+  CallGraph graph(fns);
+  for (size_t c = 0; c < graph.components.size(); c++)
+  {
+    const std::vector<IRFunction *> &members = graph.components[c];
+    std::map<Symbol, IRFunction *> before;      // the recursive callees
+    for (size_t m = 0; m < members.size(); m++)
+      before[members[m]->name] = snapshot(*members[m]);
+
+    for (size_t m = 0; m < members.size(); m++)
+    {
+      IRFunction &fn = *members[m];
+      bool changed = false;
+      // Only the calls there were to begin with: those a copy brings in
+      // were left there by the callee already.
+      std::vector<BasicBlock *> blocks = fn.blocks;
+      for (size_t i = 0; i < blocks.size(); i++)
+      {
+        BasicBlock *bb = blocks[i];
+        for (size_t k = 0; k < bb->insts.size(); k++)
+        {
+          const IRInst &inst = bb->insts[k];
+          if (inst.op != OP_CALL || !graph.by_name.count(inst.name))
+            continue;
+          if (graph.by_name[inst.name]->memoized)
+            continue;
+          const IRFunction &callee = before.count(inst.name) ? *before[inst.name]
+                                                             : *graph.by_name[inst.name];
+          size_t size = function_size(callee);
+          size_t limit = inline_limit * (graph.calls_to[inst.name] == 1 ? 4 : 1);
+          if (size > limit || function_size(fn) + size > MAX_CALLER_SIZE)
+            continue;
+          blocks.push_back(inline_call(fn, bb, k, callee));
+          changed = true;
+          break;
+        }
+      }
+      if (changed)
+      {
+        fn.compute_cfg();
+        optimize_ir(fn);
+      }
+    }
+    for (std::map<Symbol, IRFunction *>::iterator it = before.begin(); it != before.end(); ++it)
+      delete it->second;
+  }
+}
+
+//////////////////////////////////////////////////////////////////////
+//
+// Memoization
+//
+// A pure function called with the same arguments returns the same result,
+// so a recursive one, like the naive Fibonacci, need not compute it more
+// than once.  With -memoize, the backend calls such a function through a
+// cache of its results keyed on its arguments (see emit_memo_wrapper).
+// The arguments and the result must be Int, Bool or Float, all passed in
+// registers.  Inlining leaves these functions alone, so that every call
+// goes through the cache.
+//
+//////////////////////////////////////////////////////////////////////
+
+static bool is_scalar(IRType type)
+{
+  return type == IR_INT || type == IR_BOOL || type == IR_FLOAT;
+}
+
+void select_memoized(std::vector<IRFunction *> &fns, const EffectSummary &effects)
+{
+  CallGraph graph(fns);
+  for (size_t f = 0; f < fns.size(); f++)
+  {
+    IRFunction &fn = *fns[f];
+    const std::vector<IRFunction *> &callees = graph.callees[fn.name];
+    bool recursive = graph.components[graph.component[fn.name]].size() > 1 ||
+                     std::find(callees.begin(), callees.end(), &fn) != callees.end();
+    bool scalar = is_scalar(fn.ret_type) && fn.params.size() <= 6;
+    for (size_t i = 0; i < fn.params.size() && scalar; i++)
+      scalar = is_scalar(fn.vreg_type[fn.params[i]]);
+    EffectSummary::const_iterator e = effects.find(fn.name);
+    fn.memoized = recursive && scalar && e != effects.end() && e->second.pure;
+  }
+}
+
+//////////////////////////////////////////////////////////////////////
+//
+// Interprocedural constant propagation
+//
+// A parameter that every call passes the same constant, or passes on
+// unchanged from a call to itself, is set to that constant on entry, and
+// propagate_constants folds it into the body.  Where the calls disagree,
+// those passing constants for parameters the callee divides by, multiplies
+// by or tests get a copy of the callee made for those constants
+// ("name.constprop.N"), when the callee is at most SPECIALIZE_LIMIT
+// instructions and has fewer than MAX_SPECIALIZED copies so far.  Calls
+// a copy makes to the original with the same constants go to the copy.
+// Callers are visited before their callees, so constants flow down chains
+// of calls.
+//
+//////////////////////////////////////////////////////////////////////
+
+static const size_t SPECIALIZE_LIMIT = 200;
+static const int MAX_SPECIALIZED = 4;
+
+struct CallSite
+{
+  IRFunction *caller;
+  IRInst *call;
+};
+
+// Set the parameters of fn that bound has a constant for, on entry.
+static void bind_params(IRFunction &fn, const std::vector<Operand> &bound)
+{
+  BasicBlock *entry = fn.new_block();
+  for (size_t p = 0; p < bound.size(); p++)
+  {
+    if (!bound[p].is_const())
+      continue;
+    IRInst move(OP_MOV, fn.vreg_type[fn.params[p]]);
+    move.dst = fn.params[p];
+    move.a = bound[p];
+    entry->insts.push_back(move);
+  }
+  IRInst jump(OP_JMP);
+  jump.target[0] = fn.blocks[0];
+  entry->insts.push_back(jump);
+  fn.blocks.insert(fn.blocks.begin(), entry);
+  fn.compute_cfg();
+  propagate_constants(fn);
+  eliminate_dead_code(fn);
+  // nothing left to set
+  if (entry->insts.size() == 1 && entry->preds.empty())
+  {
+    fn.blocks.erase(fn.blocks.begin());
+    fn.compute_cfg();
+  }
+}
+
+// Does call pass the constants of bound?
+static bool passes(const IRInst &call, const std::vector<Operand> &bound)
+{
+  for (size_t p = 0; p < bound.size(); p++)
+    if (bound[p].is_const() && call.args[p] != bound[p])
+      return false;
+  return true;
+}
+
+static void specialize(std::vector<IRFunction *> &fns, IRFunction &fn, EffectSummary &effects)
+{
+  size_t nparams = fn.params.size();
+  std::vector<int> defs(fn.vreg_type.size(), 0);
+  std::vector<bool> worth(nparams, false);
+  for (size_t i = 0; i < fn.blocks.size(); i++)
+    for (size_t k = 0; k < fn.blocks[i]->insts.size(); k++)
+    {
+      const IRInst &inst = fn.blocks[i]->insts[k];
+      if (inst.dst >= 0)
+        defs[inst.dst]++;
+      bool folds = inst.op == OP_MUL || inst.op == OP_DIV || inst.op == OP_MOD ||
+                   inst.op == OP_CMP || inst.op == OP_SELECT || inst.op == OP_CBR;
+      for (size_t p = 0; p < nparams && folds; p++)
+        if (inst.a == Operand::vreg(fn.params[p]) || inst.b == Operand::vreg(fn.params[p]))
+          worth[p] = true;
+    }
+
+  std::vector<CallSite> sites;
+  for (size_t f = 0; f < fns.size(); f++)
+    for (size_t i = 0; i < fns[f]->blocks.size(); i++)
+      for (size_t k = 0; k < fns[f]->blocks[i]->insts.size(); k++)
+      {
+        IRInst &inst = fns[f]->blocks[i]->insts[k];
+        if (inst.op == OP_CALL && inst.name == fn.name)
+        {
+          CallSite site = {fns[f], &inst};
+          sites.push_back(site);
+        }
+      }
+  if (sites.empty())
+    return;
+
+  // the constant every call passes, if any
+  std::vector<Operand> common(nparams);
+  std::vector<bool> agree(nparams, true);
+  for (size_t s = 0; s < sites.size(); s++)
+    for (size_t p = 0; p < nparams; p++)
+    {
+      const Operand &arg = sites[s].call->args[p];
+      if (sites[s].caller == &fn && arg == Operand::vreg(fn.params[p]) && defs[arg.reg] == 0)
+        continue;
+      if (!arg.is_const() || (common[p].is_const() && common[p] != arg))
+        agree[p] = false;
+      else
+        common[p] = arg;
+    }
+  bool bound = false;
+  for (size_t p = 0; p < nparams; p++)
+  {
+    if (!agree[p] || !common[p].is_const())
+      common[p] = Operand();
+    bound = bound || common[p].is_const();
+  }
+  if (bound)
+  {
+    bind_params(fn, common);
+    return;
+  }
+
+  if (function_size(fn) > SPECIALIZE_LIMIT)
+    return;
+  std::vector<std::pair<std::vector<Operand>, IRFunction *> > copies;
+  for (size_t s = 0; s < sites.size(); s++)
+  {
+    if (sites[s].caller == &fn)
+      continue;
+    IRInst &call = *sites[s].call;
+    std::vector<Operand> constants(nparams);
+    bool any = false;
+    for (size_t p = 0; p < nparams; p++)
+      if (worth[p] && call.args[p].is_const())
+      {
+        constants[p] = call.args[p];
+        any = true;
+      }
+    if (!any)
+      continue;
+
+    size_t c = 0;
+    while (c < copies.size() && copies[c].first != constants)
+      c++;
+    if (c == copies.size())
+    {
+      if ((int)copies.size() == MAX_SPECIALIZED)
+        continue;
+      std::ostringstream name;
+      name << fn.name << ".constprop." << c;
+      IRFunction *copy = snapshot(fn);
+      copy->name = idtable.add_string((char *)name.str().c_str());
+      bind_params(*copy, constants);
+      for (size_t i = 0; i < copy->blocks.size(); i++)
+        for (size_t k = 0; k < copy->blocks[i]->insts.size(); k++)
+        {
+          IRInst &inst = copy->blocks[i]->insts[k];
+          if (inst.op == OP_CALL && inst.name == fn.name && passes(inst, constants))
+            inst.name = copy->name;
+        }
+      effects[copy->name] = effects[fn.name];
+      fns.push_back(copy);
+      copies.push_back(std::make_pair(constants, copy));
+    }
+    call.name = copies[c].second->name;
+  }
+}
+
+void specialize_calls(std::vector<IRFunction *> &fns, EffectSummary &effects)
+{
+  CallGraph graph(fns);
+  for (size_t c = graph.components.size(); c-- > 0;)
+    for (size_t m = 0; m < graph.components[c].size(); m++)
+    {
+      IRFunction &fn = *graph.components[c][m];
+      if (!fn.params.empty() && !fn.memoized)
+        specialize(fns, fn, effects);
+    }
+}
+
+void optimize_program(std::vector<IRFunction *> &fns, Symbol entry, ProgramUses &used)
+{
+  EffectSummary effects;
+  summarize_effects(fns, effects);
+  if (memoize)
+    select_memoized(fns, effects);
+  inline_calls(fns);
+  specialize_calls(fns, effects);
+  for (size_t i = 0; i < fns.size(); i++)
+  {
+    rotate_loops(*fns[i]);
+    // guards that hold on entry to the loop, as when it counts from 0
+    propagate_constants(*fns[i]);
+    number_values(*fns[i], effects);
+    eliminate_dead_code(*fns[i]);
+    // a block that merged with the arms sees what they compute
+    if (if_convert(*fns[i]))
+    {
+      number_values(*fns[i], effects);
+      eliminate_dead_code(*fns[i]);
+    }
+    hoist_loop_invariants(*fns[i], effects);
+    lay_out_blocks(*fns[i], effects);
+  }
+  eliminate_unused(fns, entry, used);
+}
@@ -0,0 +1,86 @@
+#ifndef _OPT_H_
+#define _OPT_H_
+
+#include <map>
+#include <set>
+#include "ir.h"
+
+//
+// Optimizations on the IR, run under -O between lowering and the backend.
+// Each pass leaves the preds and succs up to date.
+//
+
+// Turn calls of a function to itself that it returns the result of, as
+// is or with an Int + or *, into jumps back to its start.
+void eliminate_tail_recursion(IRFunction &fn);
+
+// Fold operations on constants and propagate constants through vregs,
+// along the paths that can actually be taken.
+void propagate_constants(IRFunction &fn);
+
+// Delete the instructions whose results are never used and that have no
+// other effect.
+void eliminate_dead_code(IRFunction &fn);
+
+// Run the passes above, in order.
+void optimize_ir(IRFunction &fn);
+
+//
+// The functions, globals and strings a whole program refers to.
+//
+struct ProgramUses
+{
+  std::set<Symbol> functions, globals, strings;
+};
+
+// Delete the functions entry cannot reach, and the stores to globals that
+// none of the remaining functions loads; collect what those use.
+void eliminate_unused(std::vector<IRFunction *> &fns, Symbol entry, ProgramUses &used);
+
+//
+// What calling a function may do besides returning its result.
+//
+struct FunctionEffects
+{
+  bool pure;                    // reads no globals and has no effect
+  bool writes_globals;          // may store to a global of the program
+};
+
+typedef std::map<Symbol, FunctionEffects> EffectSummary;    // by name
+
+// Have the pure recursive functions called through a cache of results.
+void select_memoized(std::vector<IRFunction *> &fns, const EffectSummary &effects);
+
+// Replace calls to small functions by copies of them.
+void inline_calls(std::vector<IRFunction *> &fns);
+
+// Bind the parameters that calls pass constants for, in the callee or in
+// a copy of it for those calls.
+void specialize_calls(std::vector<IRFunction *> &fns, EffectSummary &effects);
+
+// The effects of the functions of a program, following the calls.
+void summarize_effects(const std::vector<IRFunction *> &fns, EffectSummary &effects);
+
+// Move what a loop computes the same way on every iteration to before it.
+void hoist_loop_invariants(IRFunction &fn, const EffectSummary &effects);
+
+// Move the test of each loop from the top to the bottom, keeping a copy
+// at the top that guards the first iteration.
+void rotate_loops(IRFunction &fn);
+
+// Reuse the values computed before, in the block or in a block that
+// dominates it, instead of computing them again.
+void number_values(IRFunction &fn, const EffectSummary &effects);
+
+// Replace the branches around an assignment to one vreg, or two, by a
+// select of the value.  Returns whether it did any.
+bool if_convert(IRFunction &fn);
+
+// Lay out the arms of branches predicted not taken after everything else,
+// and have the headers of loops aligned.
+void lay_out_blocks(IRFunction &fn, const EffectSummary &effects);
+
+// Run the passes that need the whole program, eliminate_unused last.
+void optimize_program(std::vector<IRFunction *> &fns, Symbol entry, ProgramUses &used);
+
+#endif
@@ -0,0 +1,763 @@
+
+//**************************************************************
+//
+// The instruction buffer and the peephole optimizer, see peephole.h.
+//
+//**************************************************************
+
+#include <ctype.h>
+#include <limits.h>
+#include <map>
+#include <stdlib.h>
+#include <string.h>
+#include "peephole.h"
+
+using std::string;
+using std::vector;
+
+//////////////////////////////////////////////////////////////////////
+//
+// Parsing and printing
+//
+//////////////////////////////////////////////////////////////////////
+
+static string trim(const string &str)
+{
+  size_t b = str.find_first_not_of(" \t");
+  if (b == string::npos)
+    return "";
+  size_t e = str.find_last_not_of(" \t");
+  return str.substr(b, e - b + 1);
+}
+
+static Insn parse_line(const string &line)
+{
+  Insn insn;
+  string text = trim(line);
+  if (line.empty() || text.empty() || text[0] == '#' ||
+      (text[0] == '.' && line[0] == '\t'))
+  {
+    insn.text = line;
+    return insn;
+  }
+  if (line[0] != '\t' && text[text.size() - 1] == ':')
+  {
+    insn.kind = Insn::LABEL;
+    insn.op = text.substr(0, text.size() - 1);
+    return insn;
+  }
+  size_t end = text.find_first_of(" \t");
+  insn.kind = Insn::INSN;
+  insn.op = text.substr(0, end);
+  string rest = end == string::npos ? "" : text.substr(end);
+
+  // Split the operands at the commas outside parentheses.
+  int depth = 0;
+  size_t start = 0;
+  for (size_t i = 0; i <= rest.size(); i++)
+  {
+    if (i == rest.size() || (rest[i] == ',' && depth == 0))
+    {
+      string arg = trim(rest.substr(start, i - start));
+      if (!arg.empty())
+        insn.args.push_back(arg);
+      start = i + 1;
+    }
+    else if (rest[i] == '(')
+      depth++;
+    else if (rest[i] == ')')
+      depth--;
+  }
+  return insn;
+}
+
+void InsnBuffer::parse(const string &text)
+{
+  size_t start = 0;
+  while (start < text.size())
+  {
+    size_t end = text.find('\n', start);
+    if (end == string::npos)
+      end = text.size();
+    insns.push_back(parse_line(text.substr(start, end - start)));
+    start = end + 1;
+  }
+}
+
+void InsnBuffer::print(ostream &s)
+{
+  for (size_t i = 0; i < insns.size(); i++)
+  {
+    const Insn &insn = insns[i];
+    if (insn.kind == Insn::LABEL)
+    {
+      s << insn.op << ":" << endl;
+    }
+    else if (insn.kind == Insn::INSN)
+    {
+      s << "\t" << insn.op << "\t";
+      for (size_t k = 0; k < insn.args.size(); k++)
+        s << (k ? ", " : "") << insn.args[k];
+      s << endl;
+    }
+    else
+    {
+      s << insn.text << endl;
+    }
+  }
+}
+
+//////////////////////////////////////////////////////////////////////
+//
+// Operands and locations
+//
+// Liveness is tracked for locations: the 16 general-purpose registers
+// (numbered as in the x86 encoding), the 16 XMM registers, and the
+// %rbp-relative stack slots.  Seal never takes the address of a variable,
+// so a slot is only ever read or written through its own operand and
+// liveness is as precise for slots as it is for registers.
+//
+//////////////////////////////////////////////////////////////////////
+
+enum { RAX_ID = 0, RCX_ID, RDX_ID, RBX_ID, RSP_ID, RBP_ID, RSI_ID, RDI_ID,
+       XMM0_ID = 16, NUM_REGS = 32 };
+
+static int reg_id(const string &op)
+{
+  static const char *names[][4] = {
+    {"rax", "eax", "ax", "al"},   {"rcx", "ecx", "cx", "cl"},
+    {"rdx", "edx", "dx", "dl"},   {"rbx", "ebx", "bx", "bl"},
+    {"rsp", "esp", "sp", "spl"},  {"rbp", "ebp", "bp", "bpl"},
+    {"rsi", "esi", "si", "sil"},  {"rdi", "edi", "di", "dil"},
+  };
+  if (op.size() < 3 || op[0] != '%')
+    return -1;
+  const char *name = op.c_str() + 1;
+  for (int r = 0; r < 8; r++)
+    for (int k = 0; k < 4; k++)
+      if (strcmp(name, names[r][k]) == 0)
+        return r;
+  if (name[0] == 'r' && isdigit(name[1]))
+    return atoi(name + 1);
+  if (strncmp(name, "xmm", 3) == 0)
+    return XMM0_ID + atoi(name + 3);
+  return -1;
+}
+
+static bool is_reg(const string &op)   { return reg_id(op) >= 0; }
+static bool is_imm(const string &op)   { return !op.empty() && op[0] == '$'; }
+static bool is_mem(const string &op)   { return !op.empty() && op[0] != '%' && op[0] != '$'; }
+static bool is_xmm(const string &op)   { return reg_id(op) >= XMM0_ID; }
+static bool is_gpr(const string &op)   { int r = reg_id(op); return r >= 0 && r < XMM0_ID; }
+
+// A numeric immediate that fits an instruction's 32-bit immediate field.
+static bool is_imm32(const string &op)
+{
+  if (!is_imm(op) || !(isdigit(op[1]) || op[1] == '-'))
+    return false;
+  long long value = strtoll(op.c_str() + 1, NULL, 0);
+  return value >= INT_MIN && value <= INT_MAX;
+}
+
+static bool is_slot(const string &op)
+{
+  size_t paren = op.find('(');
+  return paren != string::npos && op.compare(paren, string::npos, "(%rbp)") == 0;
+}
+
+// The registers an operand reads to form its address.
+static void address_regs(const string &op, vector<int> &regs)
+{
+  size_t paren = op.find('(');
+  if (paren == string::npos)
+    return;
+  size_t start = paren + 1;
+  for (size_t i = start; i < op.size(); i++)
+  {
+    if (op[i] == ',' || op[i] == ')')
+    {
+      int r = reg_id(trim(op.substr(start, i - start)));
+      if (r >= 0)
+        regs.push_back(r);
+      start = i + 1;
+    }
+  }
+}
+
+//
+// What an instruction reads and writes.  An instruction not known here
+// is assumed to read everything and write nothing.
+//
+struct Effects
+{
+  vector<int> use, def;
+  bool unknown;
+  Effects() : unknown(false) { }
+};
+
+static bool starts_with(const string &str, const char *prefix)
+{
+  return str.compare(0, strlen(prefix), prefix) == 0;
+}
+
+static bool is_jump(const Insn &insn)
+{
+  return insn.kind == Insn::INSN && insn.op[0] == 'j';
+}
+
+static bool reads_flags(const string &op)
+{
+  return (op[0] == 'j' && op != "jmp") || starts_with(op, "set") ||
+         starts_with(op, "cmov") || op == "adcq" || op == "sbbq";
+}
+
+static const char *MOVES[] = {"movq", "movl", "movsd", "movaps", "movapd", "movabsq",
+                              "movzbq", "movzbl", "movslq", "cvttsd2siq", "leaq", NULL};
+static const char *BINARY[] = {"addq", "subq", "imulq", "andq", "orq", "xorq",
+                               "shlq", "shrq", "sarq", "btcq", "addsd", "subsd",
+                               "mulsd", "divsd", "xorpd", "andpd", "cvtsi2sdq", "andb",
+                               "orb", NULL};
+static const char *COMPARES[] = {"cmpq", "testq", "ucomisd", "comisd", NULL};
+static const char *UNARY[] = {"negq", "notq", "incq", "decq", NULL};
+static const char *IMM_OPS[] = {"addq", "subq", "imulq", "andq", "orq", "xorq",
+                                "cmpq", NULL};
+static const char *COMMUTATIVE[] = {"addq", "imulq", "andq", "orq", "xorq",
+                                    "addsd", "mulsd", NULL};
+
+static bool one_of(const string &op, const char **ops)
+{
+  for (int i = 0; ops[i] != NULL; i++)
+    if (op == ops[i])
+      return true;
+  return false;
+}
+
+class Locations
+{
+  std::map<string, int> slots;
+public:
+  int count() const { return NUM_REGS + slots.size(); }
+  int find(const string &op) const
+  {
+    std::map<string, int>::const_iterator it = slots.find(op);
+    return it == slots.end() ? -1 : it->second;
+  }
+  int slot(const string &op)
+  {
+    std::map<string, int>::iterator it = slots.find(op);
+    if (it != slots.end())
+      return it->second;
+    int id = count();
+    slots[op] = id;
+    return id;
+  }
+
+  // Record that op is read.
+  void read(const string &op, Effects &e)
+  {
+    int r = reg_id(op);
+    if (r >= 0)
+      e.use.push_back(r);
+    address_regs(op, e.use);
+    if (is_slot(op))
+      e.use.push_back(slot(op));
+  }
+
+  // Record that op is written (and read, for read-modify-write).
+  void write(const string &op, bool also_read, Effects &e)
+  {
+    int r = reg_id(op);
+    if (r >= 0)
+    {
+      e.def.push_back(r);
+      if (also_read)
+        e.use.push_back(r);
+      return;
+    }
+    address_regs(op, e.use);
+    if (is_slot(op))
+    {
+      e.def.push_back(slot(op));
+      if (also_read)
+        e.use.push_back(slot(op));
+    }
+  }
+};
+
+static Effects effects(const Insn &insn, Locations &locs)
+{
+  static const int ARG_REGS[] = {RDI_ID, RSI_ID, RDX_ID, RCX_ID, 8, 9, RAX_ID};
+  static const int CALLER_SAVED[] = {RAX_ID, RCX_ID, RDX_ID, RSI_ID, RDI_ID,
+                                     8, 9, 10, 11};
+  static const int RET_REGS[] = {RAX_ID, XMM0_ID, RBX_ID, RSP_ID, RBP_ID,
+                                 12, 13, 14, 15};
+
+  Effects e;
+  const string &op = insn.op;
+  const vector<string> &args = insn.args;
+  if (insn.kind != Insn::INSN)
+    return e;
+  if (op[0] == 'j')
+    return e;
+  if (one_of(op, MOVES) && args.size() == 2)
+  {
+    if (op == "leaq")
+      address_regs(args[0], e.use);
+    else
+      locs.read(args[0], e);
+    locs.write(args[1], false, e);
+  }
+  else if ((one_of(op, BINARY) || starts_with(op, "cmov")) && args.size() == 2)
+  {
+    locs.read(args[0], e);
+    locs.write(args[1], true, e);
+  }
+  else if (op == "imulq" && args.size() == 1)
+  {
+    // %rdx:%rax = %rax * args[0]
+    locs.read(args[0], e);
+    locs.write("%rax", true, e);
+    locs.write("%rdx", false, e);
+  }
+  else if (op == "imulq" && args.size() == 3)
+  {
+    locs.read(args[1], e);
+    locs.write(args[2], false, e);
+  }
+  else if (one_of(op, COMPARES))
+  {
+    for (size_t k = 0; k < args.size(); k++)
+      locs.read(args[k], e);
+  }
+  else if (one_of(op, UNARY) && args.size() == 1)
+  {
+    locs.write(args[0], true, e);
+  }
+  else if (starts_with(op, "set") && args.size() == 1)
+  {
+    locs.write(args[0], true, e);
+  }
+  else if (op == "idivq" && args.size() == 1)
+  {
+    locs.read(args[0], e);
+    locs.write("%rax", true, e);
+    locs.write("%rdx", true, e);
+  }
+  else if (op == "cqto")
+  {
+    e.use.push_back(RAX_ID);
+    e.def.push_back(RDX_ID);
+  }
+  else if (op == "call")
+  {
+    e.use.insert(e.use.end(), ARG_REGS, ARG_REGS + 7);
+    for (int r = XMM0_ID; r < XMM0_ID + 8; r++)
+      e.use.push_back(r);
+    e.def.insert(e.def.end(), CALLER_SAVED, CALLER_SAVED + 9);
+    for (int r = XMM0_ID; r < NUM_REGS; r++)
+      e.def.push_back(r);
+  }
+  else if (op == "ret")
+  {
+    e.use.insert(e.use.end(), RET_REGS, RET_REGS + 9);
+  }
+  else if (op == "leave")
+  {
+    e.use.push_back(RBP_ID);
+    e.def.push_back(RBP_ID);
+    e.def.push_back(RSP_ID);
+  }
+  else if (op == "pushq" && args.size() == 1)
+  {
+    locs.read(args[0], e);
+  }
+  else if (op == "popq" && args.size() == 1)
+  {
+    locs.write(args[0], false, e);
+  }
+  else
+  {
+    e.unknown = true;
+  }
+  return e;
+}
+
+//////////////////////////////////////////////////////////////////////
+//
+// Liveness
+//
+//////////////////////////////////////////////////////////////////////
+
+class LiveSet
+{
+  vector<unsigned long long> words;
+public:
+  explicit LiveSet(int n = 0) : words((n + 63) / 64, 0) { }
+  bool has(int i) const { return (words[i / 64] >> (i % 64)) & 1; }
+  void add(int i) { words[i / 64] |= 1ULL << (i % 64); }
+  void remove(int i) { words[i / 64] &= ~(1ULL << (i % 64)); }
+  void fill() { for (size_t k = 0; k < words.size(); k++) words[k] = ~0ULL; }
+  bool merge(const LiveSet &other)
+  {
+    bool changed = false;
+    for (size_t k = 0; k < words.size(); k++)
+    {
+      unsigned long long w = words[k] | other.words[k];
+      changed |= w != words[k];
+      words[k] = w;
+    }
+    return changed;
+  }
+};
+
+//
+// The locations live after each instruction, by the usual backward
+// dataflow over the jumps of the function.
+//
+class Liveness
+{
+  Locations locs;
+  vector<LiveSet> live_out;
+public:
+  explicit Liveness(const vector<Insn> &insns)
+  {
+    int n = insns.size();
+    vector<Effects> fx;
+    for (int i = 0; i < n; i++)
+      fx.push_back(effects(insns[i], locs));
+    std::map<string, int> labels;
+    for (int i = 0; i < n; i++)
+      if (insns[i].kind == Insn::LABEL)
+        labels[insns[i].op] = i;
+
+    int size = locs.count();
+    vector<LiveSet> live_in(n + 1, LiveSet(size));
+    live_out.assign(n, LiveSet(size));
+    for (bool changed = true; changed;)
+    {
+      changed = false;
+      for (int i = n - 1; i >= 0; i--)
+      {
+        const Insn &insn = insns[i];
+        LiveSet out(size);
+        bool falls_through = !(insn.kind == Insn::INSN &&
+                               (insn.op == "jmp" || insn.op == "ret"));
+        if (falls_through)
+          out.merge(live_in[i + 1]);
+        if (is_jump(insn))
+        {
+          std::map<string, int>::iterator target =
+              insn.args.empty() ? labels.end() : labels.find(insn.args[0]);
+          if (target != labels.end())
+            out.merge(live_in[target->second]);
+          else
+            out.fill();
+        }
+        live_out[i] = out;
+
+        LiveSet in = out;
+        if (fx[i].unknown)
+          in.fill();
+        for (size_t k = 0; k < fx[i].def.size(); k++)
+          in.remove(fx[i].def[k]);
+        for (size_t k = 0; k < fx[i].use.size(); k++)
+          in.add(fx[i].use[k]);
+        changed |= live_in[i].merge(in);
+      }
+    }
+  }
+
+  // Is operand op (a register or a stack slot) live after instruction i?
+  bool live_after(int i, const string &op)
+  {
+    int r = reg_id(op);
+    if (r >= 0)
+      return r == RSP_ID || r == RBP_ID || live_out[i].has(r);
+    if (is_slot(op))
+    {
+      int id = locs.find(op);
+      return id < 0 || live_out[i].has(id);
+    }
+    return true;
+  }
+};
+
+//////////////////////////////////////////////////////////////////////
+//
+// The peephole rules
+//
+// Each pass computes liveness, then slides over the instructions trying
+// the rules below on a window of up to three of them; the passes repeat
+// until nothing changes.  A rule that fires leaves the rest of its window
+// to the next pass, whose liveness is up to date.
+//
+//////////////////////////////////////////////////////////////////////
+
+static bool is_move(const Insn &insn)
+{
+  return insn.kind == Insn::INSN && insn.args.size() == 2 &&
+         (insn.op == "movq" || insn.op == "movsd" || insn.op == "movaps");
+}
+
+// The opcode moving 8 bytes from source to dest, or NULL if there is none.
+static const char *move_op(const string &source, const string &dest)
+{
+  if (is_mem(source) && is_mem(dest))
+    return NULL;
+  if (is_imm(source))
+    return is_gpr(dest) || (is_mem(dest) && is_imm32(source)) ? "movq" : NULL;
+  if (is_xmm(source) && is_xmm(dest))
+    return "movaps";
+  if (is_xmm(source) || is_xmm(dest))
+    return is_mem(source) || is_mem(dest) ? "movsd" : "movq";
+  return "movq";
+}
+
+// Can op take source and dest as its operands?
+static bool legal(const string &op, const string &source, const string &dest)
+{
+  if (is_imm(dest) || (is_mem(source) && is_mem(dest)))
+    return false;
+  if (op[op.size() - 2] == 's' && op[op.size() - 1] == 'd')  // addsd etc.
+    return is_xmm(dest) && !is_imm(source) && !is_gpr(source);
+  if (is_xmm(source) || is_xmm(dest))
+    return false;
+  if (is_imm(source) && !is_imm32(source))
+    return false;
+  if (op == "imulq")
+    return is_gpr(dest);
+  return true;
+}
+
+static const char *inverse_jump(const string &op)
+{
+  static const char *pairs[][2] = {
+    {"je", "jne"}, {"jz", "jnz"}, {"jl", "jge"}, {"jle", "jg"},
+    {"jb", "jae"}, {"jbe", "ja"}, {"jp", "jnp"}, {"js", "jns"},
+  };
+  for (int k = 0; k < 8; k++)
+  {
+    if (op == pairs[k][0])
+      return pairs[k][1];
+    if (op == pairs[k][1])
+      return pairs[k][0];
+  }
+  return NULL;
+}
+
+static bool mentions(const string &op, const string &reg)
+{
+  return op.find(reg) != string::npos;
+}
+
+class Peephole
+{
+  vector<Insn> &insns;
+  vector<Insn> out;
+  Liveness live;
+  bool fired;                            // the last rewrite changed something
+  std::map<string, int> references;      // label -> number of jumps to it
+
+  void keep(const Insn &insn) { out.push_back(insn); }
+  bool flags_read_after(size_t i)
+  {
+    return i + 1 < insns.size() && insns[i + 1].kind == Insn::INSN &&
+           reads_flags(insns[i + 1].op);
+  }
+
+  // Try the rules at i; return how many instructions they consumed.
+  size_t rewrite(size_t i);
+
+public:
+  explicit Peephole(vector<Insn> &v) : insns(v), live(v), fired(false)
+  {
+    for (size_t i = 0; i < insns.size(); i++)
+      if (is_jump(insns[i]) && !insns[i].args.empty())
+        references[insns[i].args[0]]++;
+  }
+
+  bool run()
+  {
+    bool changed = false;
+    for (size_t i = 0; i < insns.size();)
+    {
+      i += rewrite(i);
+      changed |= fired;
+    }
+    insns.swap(out);
+    return changed;
+  }
+};
+
+size_t Peephole::rewrite(size_t i)
+{
+  const Insn &a = insns[i];
+  const Insn *b = i + 1 < insns.size() ? &insns[i + 1] : NULL;
+  const Insn *c = i + 2 < insns.size() ? &insns[i + 2] : NULL;
+  fired = true;
+
+  if (a.kind == Insn::LABEL)
+  {
+    // A label nothing jumps to.
+    if (a.op[0] == '.' && references[a.op] == 0)
+      return 1;
+    fired = false;
+    keep(a);
+    return 1;
+  }
+  if (a.kind != Insn::INSN)
+  {
+    fired = false;
+    keep(a);
+    return 1;
+  }
+
+  // Code after a jmp or ret, up to the next label, is never reached.
+  if ((a.op == "jmp" || a.op == "ret") && b != NULL && b->kind == Insn::INSN)
+  {
+    keep(a);
+    size_t k = i + 1;
+    while (k < insns.size() && insns[k].kind == Insn::INSN)
+    {
+      if (is_jump(insns[k]) && !insns[k].args.empty())
+        references[insns[k].args[0]]--;
+      k++;
+    }
+    return k - i;
+  }
+
+  // A jump to the label right after it.
+  if (is_jump(a) && !a.args.empty())
+  {
+    for (size_t k = i + 1; k < insns.size() && insns[k].kind == Insn::LABEL; k++)
+    {
+      if (insns[k].op == a.args[0])
+      {
+        references[a.args[0]]--;
+        return 1;
+      }
+    }
+  }
+
+  // jcc L1; jmp L2; L1:  =>  jncc L2; L1:
+  if (is_jump(a) && a.op != "jmp" && inverse_jump(a.op) && b != NULL &&
+      b->kind == Insn::INSN && b->op == "jmp" && c != NULL &&
+      c->kind == Insn::LABEL && c->op == a.args[0])
+  {
+    references[a.args[0]]--;
+    keep(Insn(inverse_jump(a.op), b->args[0]));
+    return 2;
+  }
+
+  if (is_move(a))
+  {
+    const string &src = a.args[0], &dst = a.args[1];
+
+    // A move to itself, or of a value nothing reads.
+    if (src == dst || ((is_reg(dst) || is_slot(dst)) && !live.live_after(i, dst)))
+      return 1;
+
+    if (b != NULL && is_move(*b))
+    {
+      // Store to memory then load back: take the value from the register.
+      // Load from memory then store back: the store is redundant.
+      if (is_reg(src) && is_mem(dst) && b->args[0] == dst)
+      {
+        keep(a);
+        if (b->args[1] != src)
+          keep(Insn(move_op(src, b->args[1]), src, b->args[1]));
+        return 2;
+      }
+      if (is_mem(src) && is_reg(dst) && b->args[0] == dst && b->args[1] == src)
+      {
+        keep(a);
+        return 2;
+      }
+
+      // A copy through a register that dies: move directly.
+      if (is_reg(dst) && b->args[0] == dst && !live.live_after(i + 1, dst) &&
+          !mentions(b->args[1], dst))
+      {
+        const char *op = move_op(src, b->args[1]);
+        if (op != NULL && (is_imm(src) || is_xmm(src) == is_xmm(dst)))
+        {
+          keep(Insn(op, src, b->args[1]));
+          return 2;
+        }
+      }
+    }
+
+    // An immediate loaded into a register only to be an operand.
+    if (is_imm32(src) && is_gpr(dst) && b != NULL && b->kind == Insn::INSN &&
+        b->args.size() == 2 && b->args[0] == dst &&
+        one_of(b->op, IMM_OPS) && !mentions(b->args[1], dst) &&
+        !live.live_after(i + 1, dst) && legal(b->op, src, b->args[1]))
+    {
+      keep(Insn(b->op, src, b->args[1]));
+      return 2;
+    }
+
+    // mov A, T; op B, T; mov T, D  where T dies: compute into D directly.
+    if (is_reg(dst) && !mentions(src, dst) && b != NULL && c != NULL &&
+        b->kind == Insn::INSN && one_of(b->op, BINARY) && b->op != "cvtsi2sdq" &&
+        b->args.size() == 2 && b->args[1] == dst && b->args[0] != dst &&
+        is_move(*c) && c->args[0] == dst && c->args[1] != dst &&
+        !live.live_after(i + 2, dst))
+    {
+      const string &B = b->args[0], &D = c->args[1];
+      if (D == B && one_of(b->op, COMMUTATIVE) && legal(b->op, src, D))
+      {
+        keep(Insn(b->op, src, D));
+        return 3;
+      }
+      if (D == src && legal(b->op, B, D))
+      {
+        keep(Insn(b->op, B, D));
+        return 3;
+      }
+      if (is_reg(D) && is_xmm(D) == is_xmm(dst) && !mentions(B, D) &&
+          move_op(src, D) != NULL && legal(b->op, B, D))
+      {
+        keep(Insn(move_op(src, D), src, D));
+        keep(Insn(b->op, B, D));
+        return 3;
+      }
+    }
+  }
+
+  // add $1 => inc, and arithmetic that changes nothing, when the flags
+  // it sets are not looked at.
+  if ((a.op == "addq" || a.op == "subq") && a.args.size() == 2 &&
+      is_imm32(a.args[0]) && !flags_read_after(i))
+  {
+    long long value = strtoll(a.args[0].c_str() + 1, NULL, 0);
+    if (value == 0)
+      return 1;
+    if (value == 1 || value == -1)
+    {
+      bool up = (value == 1) == (a.op == "addq");
+      Insn insn;
+      insn.kind = Insn::INSN;
+      insn.op = up ? "incq" : "decq";
+      insn.args.push_back(a.args[1]);
+      keep(insn);
+      return 1;
+    }
+  }
+  if (a.op == "imulq" && a.args.size() == 2 && a.args[0] == "$1")
+    return 1;
+
+  fired = false;
+  keep(a);
+  return 1;
+}
+
+void InsnBuffer::optimize()
+{
+  for (int pass = 0; pass < 16; pass++)
+  {
+    Peephole peephole(insns);
+    if (!peephole.run())
+      break;
+  }
+}
@@ -0,0 +1,37 @@
+#ifndef _PEEPHOLE_H_
+#define _PEEPHOLE_H_
+
+#include <string>
+#include <vector>
+#include "seal-io.h"
+
+//
+// A function body as a list of instructions, between generating it and
+// printing it.  The code generator's text is parsed back into one Insn
+// per line: a label, an instruction with its operands in AT&T order, or
+// any other line, which is kept verbatim.
+//
+struct Insn
+{
+  enum Kind { LABEL, INSN, OTHER } kind;
+  std::string op;                     // opcode, or the label's name
+  std::vector<std::string> args;      // operands, source first
+  std::string text;                   // an OTHER line
+
+  Insn() : kind(OTHER) { }
+  Insn(const std::string &o, const std::string &a) : kind(INSN), op(o) { args.push_back(a); }
+  Insn(const std::string &o, const std::string &a, const std::string &b)
+    : kind(INSN), op(o) { args.push_back(a); args.push_back(b); }
+};
+
+class InsnBuffer
+{
+public:
+  std::vector<Insn> insns;
+
+  void parse(const std::string &text);  // append the lines of text
+  void optimize();                      // run the peephole optimizer
+  void print(ostream &s);
+};
+
+#endif
@@ -0,0 +1,137 @@
+
+//**************************************************************
+//
+// Linear-scan register allocation, see regalloc.h.
+//
+//**************************************************************
+
+#include <algorithm>
+#include <string.h>
+#include "emit.h"
+#include "regalloc.h"
+
+//
+// The allocatable registers.  The argument registers, %rax, %rcx, %rdx
+// and %xmm0 - %xmm7 are left to the code generator as scratch registers.
+//
+static const char *INT_CALLER_SAVED[] = {R10, R11};
+static const char *INT_CALLEE_SAVED[] = {RBX, R12, R13, R14, R15};
+static const char *FLOAT_CALLER_SAVED[] = {XMM8, XMM9, XMM10, XMM11,
+                                           XMM12, XMM13, XMM14, XMM15};
+
+#define LENGTH(a) (int)(sizeof(a) / sizeof((a)[0]))
+
+bool is_callee_saved(const char *reg)
+{
+  for (int i = 0; i < LENGTH(INT_CALLEE_SAVED); i++)
+    if (strcmp(reg, INT_CALLEE_SAVED[i]) == 0)
+      return true;
+  return false;
+}
+
+// The registers an interval may be given, in order of preference.
+static std::vector<const char *> candidates(const LiveInterval &iv)
+{
+  std::vector<const char *> regs;
+  if (iv.is_float)
+  {
+    if (!iv.across_call)
+      regs.insert(regs.end(), FLOAT_CALLER_SAVED,
+                  FLOAT_CALLER_SAVED + LENGTH(FLOAT_CALLER_SAVED));
+    return regs;
+  }
+  if (!iv.across_call)
+    regs.insert(regs.end(), INT_CALLER_SAVED,
+                INT_CALLER_SAVED + LENGTH(INT_CALLER_SAVED));
+  regs.insert(regs.end(), INT_CALLEE_SAVED,
+              INT_CALLEE_SAVED + LENGTH(INT_CALLEE_SAVED));
+  return regs;
+}
+
+static bool in(const std::vector<const char *> &regs, const char *reg)
+{
+  return std::find(regs.begin(), regs.end(), reg) != regs.end();
+}
+
+int linear_scan(std::vector<LiveInterval> &intervals, bool use_registers)
+{
+  std::vector<int> order;
+  for (int i = 0; i < (int)intervals.size(); i++)
+    order.push_back(i);
+  std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+    return intervals[a].start < intervals[b].start;
+  });
+
+  // intervals currently holding a register
+  std::vector<int> active;
+  for (size_t i = 0; use_registers && i < order.size(); i++)
+  {
+    LiveInterval &cur = intervals[order[i]];
+    for (size_t k = 0; k < active.size();)
+    {
+      if (intervals[active[k]].end < cur.start)
+        active.erase(active.begin() + k);
+      else
+        k++;
+    }
+
+    std::vector<const char *> regs = candidates(cur);
+    std::vector<const char *> taken;
+    for (size_t k = 0; k < active.size(); k++)
+      taken.push_back(intervals[active[k]].reg);
+    for (size_t k = 0; k < regs.size() && cur.reg == NULL; k++)
+      if (!in(taken, regs[k]))
+        cur.reg = regs[k];
+    if (cur.reg != NULL)
+    {
+      active.push_back(order[i]);
+      continue;
+    }
+
+    // No register is free: spill whichever of cur and the values holding
+    // one of its registers stays live the longest.
+    int victim = -1;
+    for (size_t k = 0; k < active.size(); k++)
+    {
+      LiveInterval &iv = intervals[active[k]];
+      if (in(regs, iv.reg) && (victim < 0 || iv.end > intervals[active[victim]].end))
+        victim = k;
+    }
+    if (victim >= 0 && intervals[active[victim]].end > cur.end)
+    {
+      cur.reg = intervals[active[victim]].reg;
+      intervals[active[victim]].reg = NULL;
+      active[victim] = order[i];
+    }
+  }
+
+  // Stack slots for everything left without a register.
+  int nslots = 0;
+  std::vector<int> free_slots;
+  std::vector<int> holding;
+  for (size_t i = 0; i < order.size(); i++)
+  {
+    LiveInterval &cur = intervals[order[i]];
+    if (cur.reg != NULL)
+      continue;
+    for (size_t k = 0; k < holding.size();)
+    {
+      if (intervals[holding[k]].end < cur.start)
+      {
+        free_slots.push_back(intervals[holding[k]].slot);
+        holding.erase(holding.begin() + k);
+      }
+      else
+        k++;
+    }
+    if (free_slots.empty())
+      cur.slot = nslots++;
+    else
+    {
+      cur.slot = free_slots.back();
+      free_slots.pop_back();
+    }
+    holding.push_back(order[i]);
+  }
+  return nslots;
+}
@@ -0,0 +1,40 @@
+#ifndef _REGALLOC_H_
+#define _REGALLOC_H_
+
+#include <vector>
+
+//
+// Linear-scan register allocation.
+//
+// The code generator numbers the values of a function 0..n-1 and gives
+// each one a live interval over some linear numbering of the function's
+// code.  linear_scan walks the intervals in order of their start and
+// hands every value a register of its class, or, when none is free, spills
+// whichever competing value ends last.  Spilled values get stack slots,
+// numbered from 0; a slot is reused once the interval holding it is over.
+//
+// Values live across a call may only use callee-saved registers.  There
+// are no callee-saved XMM registers, so Float values live across a call
+// are always spilled.
+//
+struct LiveInterval
+{
+  int start;            // first position where the value is live
+  int end;              // last position where the value is live
+  bool is_float;        // needs an XMM register rather than a GPR
+  bool across_call;     // live across a call
+  const char *reg;      // out: the register, or NULL if spilled
+  int slot;             // out: the stack slot, if spilled
+
+  LiveInterval(int pos, bool f) : start(pos), end(pos), is_float(f),
+                                  across_call(false), reg(NULL), slot(-1) { }
+};
+
+// Allocate registers (or, if use_registers is false, only stack slots)
+// for the intervals.  Returns the number of stack slots used.
+int linear_scan(std::vector<LiveInterval> &intervals, bool use_registers);
+
+// Is reg one the callee has to preserve?
+bool is_callee_saved(const char *reg);
+
+#endif
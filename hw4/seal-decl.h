@@ -17,7 +17,6 @@ public:
     virtual Symbol getName() = 0;
     virtual Symbol getType() = 0;
     virtual void check() = 0;
-    virtual void code(ostream&) = 0;
 };
 
 
@@ -54,7 +53,6 @@ public:
    void dump_with_types(ostream&,int);
    bool isCallDecl(){return false;}
    void check();
-   void code(ostream&){}
 };
 
 class CallDecl_class : public Decl_class {
@@ -82,7 +80,8 @@ public:
    void dump_with_types(ostream&,int);  
    bool isCallDecl(){return true;}
    void check();
-   void code(ostream&);
+   IRFunction *code_ir();
+   void code_body(IRBuilder&);
 };
 
 typedef class Decl_class *Decl;
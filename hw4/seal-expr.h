@@ -31,7 +31,8 @@ public:
    virtual Expr copy_Expr() = 0;
    virtual Symbol checkType() = 0;
    virtual bool is_empty_Expr() = 0;
-   virtual void code(ostream&) = 0;
+   virtual void code(IRBuilder&) = 0;
+   virtual void code_cond(IRBuilder&, BasicBlock *if_true, BasicBlock *if_false);
 };
 
 class Call_class : public Expr_class {
@@ -51,7 +52,7 @@ public:
    void dump_type(ostream& , int );
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   void code(IRBuilder&);
 };
 
 
@@ -68,7 +69,7 @@ public:
    void dump_type(ostream& , int );
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   void code(IRBuilder&);
 };
 
 // define constructor - expr
@@ -86,7 +87,7 @@ public:
    void dump_with_types(ostream&,int); 
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   void code(IRBuilder&);
 };
 
 // define constructor - add
@@ -104,7 +105,7 @@ public:
    void dump_with_types(ostream&,int); 
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   void code(IRBuilder&);
 };
 
 // define constructor - minus
@@ -122,7 +123,7 @@ public:
    void dump_with_types(ostream&,int); 
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   void code(IRBuilder&);
 };
 
 // define constructor - multi
@@ -140,7 +141,7 @@ public:
    void dump_with_types(ostream&,int);
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   void code(IRBuilder&);
 };
 
 // define constructor - divide
@@ -158,7 +159,7 @@ public:
    void dump_with_types(ostream&,int); 
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   void code(IRBuilder&);
 };
 
 // define constructor - mod
@@ -176,7 +177,7 @@ public:
    void dump_with_types(ostream&,int); 
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   void code(IRBuilder&);
 };
 
 // define constructor - -
@@ -192,7 +193,7 @@ public:
    void dump_with_types(ostream&,int); 
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   void code(IRBuilder&);
 };
 
 // define constructor - <
@@ -210,7 +211,8 @@ public:
    void dump_with_types(ostream&,int); 
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   void code(IRBuilder&);
+   void code_cond(IRBuilder&, BasicBlock*, BasicBlock*);
 };
 
 // define constructor - <=
@@ -228,7 +230,8 @@ public:
    void dump_with_types(ostream&,int); 
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   void code(IRBuilder&);
+   void code_cond(IRBuilder&, BasicBlock*, BasicBlock*);
 };
 
 // define constructor - ==
@@ -246,7 +249,8 @@ public:
    void dump_with_types(ostream&,int); 
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   void code(IRBuilder&);
+   void code_cond(IRBuilder&, BasicBlock*, BasicBlock*);
 };
 
 // define constructor - !=
@@ -264,7 +268,8 @@ public:
    void dump_with_types(ostream&,int); 
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   void code(IRBuilder&);
+   void code_cond(IRBuilder&, BasicBlock*, BasicBlock*);
 };
 
 // define constructor - >=
@@ -282,7 +287,8 @@ public:
    void dump_with_types(ostream&,int); 
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   void code(IRBuilder&);
+   void code_cond(IRBuilder&, BasicBlock*, BasicBlock*);
 };
 
 // define constructor - >
@@ -300,7 +306,8 @@ public:
    void dump_with_types(ostream&,int); 
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   void code(IRBuilder&);
+   void code_cond(IRBuilder&, BasicBlock*, BasicBlock*);
 };
 
 // define constructor - and &&
@@ -318,7 +325,8 @@ public:
    void dump_with_types(ostream&,int); 
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   void code(IRBuilder&);
+   void code_cond(IRBuilder&, BasicBlock*, BasicBlock*);
 };
 
 // define constructor - or ||
@@ -336,7 +344,8 @@ public:
    void dump_with_types(ostream&,int); 
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   void code(IRBuilder&);
+   void code_cond(IRBuilder&, BasicBlock*, BasicBlock*);
 };
 
 // define constructor - xor ^
@@ -354,7 +363,7 @@ public:
    void dump_with_types(ostream&,int); 
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   void code(IRBuilder&);
 };
 
 // define constructor - not !
@@ -370,7 +379,8 @@ public:
    void dump_with_types(ostream&,int); 
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   void code(IRBuilder&);
+   void code_cond(IRBuilder&, BasicBlock*, BasicBlock*);
 };
 
 // define constructor - bitnot ~
@@ -386,7 +396,7 @@ public:
    void dump_with_types(ostream&,int); 
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   void code(IRBuilder&);
 };
 
 class Bitand_class : public Expr_class {
@@ -403,7 +413,7 @@ public:
    void dump_with_types(ostream&,int); 
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   void code(IRBuilder&);
 };
 
 class Bitor_class : public Expr_class {
@@ -420,7 +430,7 @@ public:
    void dump_with_types(ostream&,int); 
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   void code(IRBuilder&);
 };
 
 // define constructconst_int - const_int
@@ -436,7 +446,7 @@ public:
    void dump_with_types(ostream&,int); 
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   void code(IRBuilder&);
 };
 
 // define constructconst_string - const_string
@@ -452,7 +462,7 @@ public:
    void dump_with_types(ostream&,int); 
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   void code(IRBuilder&);
 };
 
 // define constructconst_float - const_float
@@ -468,7 +478,7 @@ public:
    void dump_with_types(ostream&,int); 
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   void code(IRBuilder&);
 };
 
 // define constructconst_bool - const_bool
@@ -484,7 +494,8 @@ public:
    void dump_with_types(ostream&,int); 
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   void code(IRBuilder&);
+   void code_cond(IRBuilder&, BasicBlock*, BasicBlock*);
 };
 
 class Object_class : public Expr_class {
@@ -500,7 +511,7 @@ public:
    void dump_with_types(ostream&,int); 
    bool is_empty_Expr(){ return false;}
    Symbol checkType();
-   void code(ostream&);
+   void code(IRBuilder&);
 };
 
 // define constructor - no_expr
@@ -514,7 +525,7 @@ public:
    void dump_with_types(ostream&,int); 
    bool is_empty_Expr(){ return true;}
    Symbol checkType();
-   void code(ostream&);
+   void code(IRBuilder&);
 };
 
 
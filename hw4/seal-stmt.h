@@ -31,7 +31,7 @@ public:
 	virtual void dump_with_types(ostream&,int) = 0; 
 	virtual void dump(ostream&,int) = 0;
 	virtual void check(Symbol) = 0;
-	virtual void code(ostream&) = 0;
+	virtual void code(IRBuilder&) = 0;
 };
 
 class StmtBlock_class : public Stmt_class {
@@ -51,7 +51,7 @@ public:
 	void dump(ostream& , int );
 	void dump_with_types(ostream&,int);
 	void check(Symbol);
-	void code(ostream&);
+	void code(IRBuilder&);
 };
 
 class IfStmt_class : public Stmt_class {
@@ -72,7 +72,7 @@ public:
 	void dump(ostream& stream, int n);
 	void dump_with_types(ostream&,int);
 	void check(Symbol);
-	void code(ostream&);
+	void code(IRBuilder&);
 };
 
 
@@ -93,7 +93,7 @@ public:
 	void dump(ostream& stream, int n);
 	void dump_with_types(ostream&,int);
 	void check(Symbol);
-	void code(ostream&);
+	void code(IRBuilder&);
 };
 
 class ForStmt_class : public Stmt_class {
@@ -115,7 +115,7 @@ public:
 	void dump(ostream& stream, int n);
 	void dump_with_types(ostream&,int);
 	void check(Symbol);
-	void code(ostream&);
+	void code(IRBuilder&);
 };
 
 
@@ -132,7 +132,7 @@ public:
     void dump_with_types(ostream&,int);
     void dump(ostream& stream, int n);
 	void check(Symbol);
-	void code(ostream&);
+	void code(IRBuilder&);
 };
 
 class ContinueStmt_class : public Stmt_class {
@@ -142,7 +142,7 @@ public:
     void dump_with_types(ostream&,int);
     void dump(ostream& stream, int n);
 	void check(Symbol);
-	void code(ostream&);
+	void code(IRBuilder&);
 };
 
 
@@ -153,7 +153,7 @@ public:
     void dump_with_types(ostream&,int);
     void dump(ostream& stream, int n);
 	void check(Symbol);
-	void code(ostream&);
+	void code(IRBuilder&);
 };
 
 typedef class Program_class *Program;
@@ -59,6 +59,11 @@ typedef Actual_class *Actual;
 class Constant_class;
 typedef Constant_class *Constant;
 
+// code generation lowers the tree into the IR of ir.h
+class IRBuilder;
+struct BasicBlock;
+struct IRFunction;
+
 
 typedef list_node<VariableDecl> VariableDecls_class;
 typedef VariableDecls_class *VariableDecls;
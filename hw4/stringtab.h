@@ -96,14 +96,28 @@ typedef FloatEntry *FloatEntryP;
 //
 //////////////////////////////////////////////////////////////////////////
 
-template <class Elem> 
+//
+// A string table keeps its entries in a dense array indexed by the
+// entry's index, plus an open-addressing hash index over (bytes, len).
+// Each bucket holds an entry index + 1, or 0 if the bucket is empty;
+// the number of buckets is always a power of two and at most half full.
+//
+template <class Elem>
 class StringTable
 {
 protected:
-   List<Elem> *tbl;   // a string table is a list
-   int index;         // the current index
+   Elem **tbl;        // tbl[i] is the entry whose index is i
+   unsigned *hashes;  // hashes[i] is the hash of tbl[i]'s string
+   int index;         // the current index (= number of entries)
+   int capacity;      // allocated length of tbl and hashes
+   int *buckets;      // the hash index
+   int nbuckets;      // number of buckets
+
+   int find_bucket(char *s, int len, unsigned hash);
+   void grow();
 public:
-   StringTable(): tbl((List<Elem> *) NULL), index(0) { }   // an empty table
+   StringTable(): tbl((Elem **) NULL), hashes((unsigned *) NULL), index(0),
+                  capacity(0), buckets((int *) NULL), nbuckets(0) { }   // an empty table
    // The following methods each add a string to the string table.  
    // Only one copy of each string is maintained.  
    // Returns a pointer to the string table entry with the string.
@@ -15,6 +15,30 @@ extern void print_seal_token(int tok);
 extern void fatal_error(char *);
 extern void print_escaped_string(ostream& str, const char *s);
 extern char *pad(int);
+
+//
+// The output sink of a compiler phase.  What is written to a stream
+// over an OutputBuffer piles up in one growable buffer and reaches the
+// file descriptor in a single write() when the buffer is flushed or
+// destroyed.  Syncing (as endl does) costs nothing, so the dumps and the
+// generated assembly no longer make a system call per line.
+//
+class OutputBuffer : public std::streambuf
+{
+  int fd;
+  char *buf;
+  size_t capacity;
+
+  void reserve(size_t n);
+protected:
+  virtual int_type overflow(int_type c);
+  virtual std::streamsize xsputn(const char *s, std::streamsize n);
+  virtual int sync() { return 0; }
+public:
+  explicit OutputBuffer(int fd);
+  ~OutputBuffer();
+  bool flush();                  // write everything out; false on error
+};
 /*  On some machines strdup is not in the standard library. */
 //char *strdup(const char *s);
 
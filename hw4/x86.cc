@@ -0,0 +1,1350 @@
+
+//**************************************************************
+//
+// The x86-64 backend, see x86.h.
+//
+//**************************************************************
+
+#include "cgen.h"
+
+using namespace std;
+
+extern bool disable_reg_alloc;
+extern int cgen_optimize;
+extern Symbol print;
+
+// the next free label number, for .POS and .MEMO labels
+static int num_label = 0;
+
+static char *CALL_REGS[] = {RDI, RSI, RDX, RCX, R8, R9};
+static char *CALL_XMM[] = {XMM0, XMM1, XMM2, XMM3, XMM4, XMM5, XMM6, XMM7};
+static const int CALL_REGS_NUM = 6;
+static const int CALL_XMM_NUM = 8;
+
+//////////////////////////////////////////////////////////////////////////////
+//
+//  emit_* procedures
+//
+//  emit_X  writes code for operation "X" to the output stream.
+//  There is an emit_X for each opcode X, as well as emit_ functions
+//  for generating names according to the naming conventions (see emit.h)
+//  and calls to support functions defined in the trap handler.
+//
+//  Register names and addresses are passed as strings.  See `emit.h'
+//  for symbolic names you can use to refer to the strings.
+//
+//////////////////////////////////////////////////////////////////////////////
+
+static void emit_mov(const char *source, const char *dest, ostream &s)
+{
+  s << MOV << source << COMMA << dest << endl;
+}
+
+static void emit_rmmov(const char *source_reg, int offset, const char *base_reg, ostream &s)
+{
+  s << MOV << source_reg << COMMA << offset << "(" << base_reg << ")"
+    << endl;
+}
+
+static void emit_add(const char *source_reg, const char *dest_reg, ostream &s)
+{
+  s << ADD << source_reg << COMMA << dest_reg << endl;
+}
+
+static void emit_sub(const char *source_reg, const char *dest_reg, ostream &s)
+{
+  s << SUB << source_reg << COMMA << dest_reg << endl;
+}
+
+static void emit_mul(const char *source_reg, const char *dest_reg, ostream &s)
+{
+  s << MUL << source_reg << COMMA << dest_reg << endl;
+}
+
+static void emit_div(const char *dest_reg, ostream &s)
+{
+  s << DIV << dest_reg << endl;
+}
+
+static void emit_cqto(ostream &s)
+{
+  s << CQTO << endl;
+}
+
+static void emit_neg(const char *dest_reg, ostream &s)
+{
+  s << NEG << dest_reg << endl;
+}
+
+static void emit_and(const char *source_reg, const char *dest_reg, ostream &s)
+{
+  s << AND << source_reg << COMMA << dest_reg << endl;
+}
+
+static void emit_xor(const char *source_reg, const char *dest_reg, ostream &s)
+{
+  s << XOR << source_reg << COMMA << dest_reg << endl;
+}
+
+static void emit_not(const char *dest_reg, ostream &s)
+{
+  s << NOT << " " << dest_reg << endl;
+}
+
+static void emit_movsd(const char *source, const char *dest, ostream &s)
+{
+  s << MOVSD << source << COMMA << dest << endl;
+}
+
+static void emit_movaps(const char *source, const char *dest, ostream &s)
+{
+  s << MOVAPS << source << COMMA << dest << endl;
+}
+
+static void emit_cmp(const char *source_reg, const char *dest_reg, ostream &s)
+{
+  s << CMP << source_reg << COMMA << dest_reg << endl;
+}
+
+static void emit_test(const char *source_reg, const char *dest_reg, ostream &s)
+{
+  s << TEST << source_reg << COMMA << dest_reg << endl;
+}
+
+static void emit_ucompisd(const char *source_reg, const char *dest_reg, ostream &s)
+{
+  s << UCOMPISD << source_reg << COMMA << dest_reg << endl;
+}
+
+static void emit_call(const char *dest, ostream &s)
+{
+  s << CALL << " " << dest << endl;
+}
+
+static void emit_ret(ostream &s)
+{
+  s << RET << endl;
+}
+
+static void emit_push(const char *reg, ostream &s)
+{
+  s << PUSH << " " << reg << endl;
+}
+
+static void emit_pop(const char *reg, ostream &s)
+{
+  s << POP << " " << reg << endl;
+}
+
+static void emit_leave(ostream &s)
+{
+  s << LEAVE << endl;
+}
+
+static void emit_int_to_float(const char *int_reg, const char *float_mmx, ostream &s)
+{
+  s << CVTSI2SDQ << int_reg << COMMA << float_mmx << endl;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Frame layout and register allocation
+//
+// Every vreg of the function lives in a register or in an 8-byte stack slot,
+// as decided by linear scan (see regalloc.h); with -r, every vreg gets a
+// stack slot.  The blocks are numbered in layout order, each with a
+// position for its entry and two per instruction, one where it reads its
+// operands and a later one where it writes its result, and a vreg's live
+// interval runs from the first to the last position where it is live:
+// where it is defined or used, and the entry and exit of the blocks it is
+// live into and out of.  An instruction's result may thus share the
+// register of an operand that dies there; the code emitted for every
+// instruction reads all its operands before it writes the result.  The
+// parameters are defined before the entry block.
+//
+// The frame is, from %rbp down: the callee-saved registers the function
+// uses, pushed by the prologue, the stack slots, and the outgoing stack
+// arguments at the bottom.  The prologue reserves all of it with a single
+// subq and %rsp stays put, 16-byte aligned, for the whole body.  Every
+// return jumps to the one epilogue at the end of the function.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static IRFunction *fn;                  // the function being emitted
+static std::vector<std::string> locations;      // by vreg
+static std::vector<const char *> saved_regs;    // callee-saved registers in use
+static int saved_size;                  // bytes of saved registers
+static int frame_bottom;                // offset of the lowest stack slot
+static int outgoing_size;               // bytes of outgoing stack arguments
+static int return_pos;                  // label of the epilogue
+static std::vector<int> block_label;    // by block id
+
+static bool is_float_vreg(int v)
+{
+  return fn->vreg_type[v] == IR_FLOAT;
+}
+
+// The bytes of stack arguments a call passes.
+static int stack_args_size(const IRInst &call)
+{
+  int ints = 0, floats = 0, size = 0;
+  for (size_t i = 0; i < call.args.size(); i++)
+  {
+    const Operand &arg = call.args[i];
+    bool is_float = arg.is_vreg() ? is_float_vreg(arg.reg) : arg.kind == Operand::FLOAT;
+    if (is_float ? floats++ >= CALL_XMM_NUM : ints++ >= CALL_REGS_NUM)
+      size += 8;
+  }
+  return size;
+}
+
+static void allocate_vregs()
+{
+  size_t nvregs = fn->vreg_type.size();
+  std::vector<int> first(nvregs, INT_MAX), last(nvregs, -1);
+  std::vector<int> call_positions;
+  IRLiveness liveness(*fn);
+  outgoing_size = 0;
+
+  int pos = 0;
+  for (size_t i = 0; i < fn->blocks.size(); i++)
+  {
+    BasicBlock *bb = fn->blocks[i];
+    int block_start = ++pos;
+    for (size_t k = 0; k < bb->insts.size(); k++)
+    {
+      const IRInst &inst = bb->insts[k];
+      int use_pos = ++pos;
+      int def_pos = ++pos;
+      std::vector<int> read;
+      inst.uses(read);
+      for (size_t r = 0; r < read.size(); r++)
+      {
+        first[read[r]] = std::min(first[read[r]], use_pos);
+        last[read[r]] = std::max(last[read[r]], use_pos);
+      }
+      if (inst.dst >= 0)
+      {
+        first[inst.dst] = std::min(first[inst.dst], def_pos);
+        last[inst.dst] = std::max(last[inst.dst], def_pos);
+      }
+      if (inst.op == OP_CALL)
+      {
+        call_positions.push_back(use_pos);
+        outgoing_size = std::max(outgoing_size, stack_args_size(inst));
+      }
+    }
+    std::vector<int> live;
+    liveness.live_in[bb->id].members(live);
+    for (size_t r = 0; r < live.size(); r++)
+      first[live[r]] = std::min(first[live[r]], block_start);
+    live.clear();
+    liveness.live_out[bb->id].members(live);
+    for (size_t r = 0; r < live.size(); r++)
+      last[live[r]] = std::max(last[live[r]], pos);
+  }
+
+  // The parameters are all defined on entry; vregs that never appear, like
+  // an unused variable, need no location.
+  for (size_t i = 0; i < fn->params.size(); i++)
+    if (last[fn->params[i]] >= 0)
+      first[fn->params[i]] = 0;
+  std::vector<LiveInterval> intervals;
+  std::vector<int> interval_of(nvregs, -1);
+  for (size_t v = 0; v < nvregs; v++)
+  {
+    if (last[v] < 0)
+      continue;
+    LiveInterval iv(first[v], is_float_vreg(v));
+    iv.end = last[v];
+    std::vector<int>::iterator call =
+        std::upper_bound(call_positions.begin(), call_positions.end(), iv.start);
+    iv.across_call = call != call_positions.end() && *call < iv.end;
+    interval_of[v] = intervals.size();
+    intervals.push_back(iv);
+  }
+
+  int nslots = linear_scan(intervals, !disable_reg_alloc);
+  saved_regs.clear();
+  for (size_t k = 0; k < intervals.size(); k++)
+  {
+    const char *reg = intervals[k].reg;
+    if (reg != NULL && is_callee_saved(reg) &&
+        std::find(saved_regs.begin(), saved_regs.end(), reg) == saved_regs.end())
+      saved_regs.push_back(reg);
+  }
+  saved_size = 8 * saved_regs.size();
+  frame_bottom = -saved_size - 8 * nslots;
+  locations.assign(nvregs, std::string());
+  for (size_t v = 0; v < nvregs; v++)
+  {
+    if (interval_of[v] < 0)
+      continue;
+    const LiveInterval &iv = intervals[interval_of[v]];
+    if (iv.reg != NULL)
+    {
+      locations[v] = iv.reg;
+    }
+    else
+    {
+      std::ostringstream slot;
+      slot << -saved_size - 8 * (iv.slot + 1) << "(" << RBP << ")";
+      locations[v] = slot.str();
+    }
+  }
+}
+
+// Bytes to subtract from %rsp after the pushes, keeping it 16-byte aligned.
+static int frame_size()
+{
+  int size = -frame_bottom + outgoing_size;
+  size = (size + 15) & ~15;
+  return size - saved_size;
+}
+
+static void emit_prologue(ostream &s)
+{
+  emit_push(RBP, s);
+  emit_mov(RSP, RBP, s);
+  for (size_t k = 0; k < saved_regs.size(); k++)
+    emit_push(saved_regs[k], s);
+  int size = frame_size();
+  if (size > 0)
+    s << SUB << "$" << size << COMMA << RSP << endl;
+}
+
+static void emit_epilogue(ostream &s)
+{
+  s << POSITION << return_pos << ":" << endl;
+  if (!saved_regs.empty() && frame_size() > 0)
+    s << LEA << -saved_size << "(" << RBP << ")" << COMMA << RSP << endl;
+  for (size_t k = saved_regs.size(); k-- > 0;)
+    emit_pop(saved_regs[k], s);
+  emit_leave(s);
+  emit_ret(s);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Operands
+//
+// Operands are register names ("%rbx", "%xmm8"), immediates ("$5") or
+// memory references ("-64(%rbp)", "x(%rip)").  A Float constant is read
+// from the pool of them that emit_float_constants puts in .rodata, as SSE
+// instructions take no immediates, and a String constant is the address
+// of its string table entry.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static std::map<unsigned long long, int> float_constants;  // bits -> label
+
+static bool is_imm(const char *op)
+{
+  return op[0] == '$';
+}
+
+static bool is_mem(const char *op)
+{
+  return op[0] != '%' && op[0] != '$';
+}
+
+static bool is_xmm(const char *op)
+{
+  return strncmp(op, "%xmm", 4) == 0;
+}
+
+// Does the immediate op fit the sign-extended 32 bits of an instruction?
+static bool is_imm32(const char *op)
+{
+  long long value = strtoll(op + 1, NULL, 0);
+  return value >= INT_MIN && value <= INT_MAX;
+}
+
+static std::string operand(const Operand &o)
+{
+  std::ostringstream s;
+  switch (o.kind)
+  {
+  case Operand::VREG:
+    return locations[o.reg];
+  case Operand::INT:
+    s << "$" << o.ival;
+    break;
+  case Operand::FLOAT:
+  {
+    unsigned long long bits;
+    memcpy(&bits, &o.fval, sizeof(bits));
+    std::map<unsigned long long, int>::iterator it = float_constants.find(bits);
+    if (it == float_constants.end())
+      it = float_constants.insert(std::make_pair(bits, (int)float_constants.size())).first;
+    s << FLOATCONST_PREFIX << it->second << "(" << RIP << ")";
+    break;
+  }
+  case Operand::STRING:
+    static_cast<StringEntry *>(o.sym)->code_ref(s);
+    break;
+  default:
+    break;
+  }
+  return s.str();
+}
+
+static bool is_float_operand(const Operand &o)
+{
+  return o.is_vreg() ? is_float_vreg(o.reg) : o.kind == Operand::FLOAT;
+}
+
+//
+// Move 8 bytes between any two operands (an immediate only as the source),
+// going through %rax when x86 has no direct move.
+//
+static void emit_move(const char *source, const char *dest, ostream &s)
+{
+  if (strcmp(source, dest) == 0)
+    return;
+  if (is_imm(source))
+  {
+    if (is_xmm(dest) || (is_mem(dest) && !is_imm32(source)))
+    {
+      emit_mov(source, RAX, s);
+      source = RAX;
+    }
+    emit_mov(source, dest, s);
+  }
+  else if (is_xmm(source) && is_xmm(dest))
+  {
+    emit_movaps(source, dest, s);
+  }
+  else if ((is_xmm(source) && is_mem(dest)) || (is_mem(source) && is_xmm(dest)))
+  {
+    emit_movsd(source, dest, s);
+  }
+  else if (is_mem(source) && is_mem(dest))
+  {
+    emit_mov(source, RAX, s);
+    emit_mov(RAX, dest, s);
+  }
+  else
+  {
+    emit_mov(source, dest, s);
+  }
+}
+
+static void emit_move(const std::string &source, const std::string &dest, ostream &s)
+{
+  emit_move(source.c_str(), dest.c_str(), s);
+}
+
+static void emit_branch(const char *jcc, int label, ostream &s)
+{
+  s << jcc << " " << POSITION << label << endl;
+}
+
+static void emit_label(int label, ostream &s)
+{
+  s << POSITION << label << ":" << endl;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Instructions
+//
+///////////////////////////////////////////////////////////////////////////////
+
+//
+// Strength reduction
+//
+// A multiplication by a constant becomes a move, a negation, a shift or a
+// leaq where one does, and a division or remainder by a constant other
+// than 0 a shift or a multiplication by its reciprocal.  The sequences use
+// only the scratch registers and write the result last, as emit_arith and
+// emit_divide do.
+//
+
+static bool is_power_of_two(unsigned long long x)
+{
+  return x != 0 && (x & (x - 1)) == 0;
+}
+
+static int log2_of(unsigned long long x)
+{
+  int k = 0;
+  while (x >>= 1)
+    k++;
+  return k;
+}
+
+static void emit_shift(const char *op, int count, const char *dest, ostream &s)
+{
+  s << op << "$" << count << COMMA << dest << endl;
+}
+
+// Emit dest = a * b for a constant b; false if imulq is as good.
+static bool emit_multiply_by_constant(const std::string &a, long long b,
+                                      const std::string &dest, ostream &s)
+{
+  unsigned long long magnitude = b < 0 ? -(unsigned long long)b : b;
+  const char *acc = is_mem(dest.c_str()) && dest != a ? RAX : dest.c_str();
+  if (b == 0)
+  {
+    emit_mov("$0", dest.c_str(), s);
+  }
+  else if (is_power_of_two(magnitude))
+  {
+    emit_move(a.c_str(), acc, s);
+    if (magnitude > 1)
+      emit_shift(SHL, log2_of(magnitude), acc, s);
+    if (b < 0)
+      emit_neg(acc, s);
+    emit_move(acc, dest.c_str(), s);
+  }
+  else if (b == 3 || b == 5 || b == 9)
+  {
+    // leaq (x,x,n-1) needs x and the result in registers
+    const char *x = is_mem(a.c_str()) ? RAX : a.c_str();
+    emit_move(a.c_str(), x, s);
+    acc = is_mem(dest.c_str()) ? RAX : dest.c_str();
+    s << LEA << "(" << x << "," << x << "," << b - 1 << ")" << COMMA << acc << endl;
+    emit_move(acc, dest.c_str(), s);
+  }
+  else
+  {
+    return false;
+  }
+  return true;
+}
+
+//
+// The magic number M and shift s for signed division by d, |d| >= 2, as in
+// Hacker's Delight, section 10-1: the quotient n / d is the high 64 bits of
+// M * n, corrected by n when M and d differ in sign, shifted right by s,
+// plus one if that is negative.
+//
+static void magic_divisor(long long d, long long &magic, int &shift)
+{
+  const unsigned long long two63 = 1ULL << 63;
+  unsigned long long ad = d < 0 ? -(unsigned long long)d : d;
+  unsigned long long t = two63 + ((unsigned long long)d >> 63);
+  unsigned long long anc = t - 1 - t % ad;        // |nc|
+  unsigned long long q1 = two63 / anc, r1 = two63 - q1 * anc;
+  unsigned long long q2 = two63 / ad, r2 = two63 - q2 * ad;
+  unsigned long long delta;
+  int p = 63;
+  do
+  {
+    p++;
+    q1 *= 2;
+    r1 *= 2;
+    if (r1 >= anc)
+    {
+      q1++;
+      r1 -= anc;
+    }
+    q2 *= 2;
+    r2 *= 2;
+    if (r2 >= ad)
+    {
+      q2++;
+      r2 -= ad;
+    }
+    delta = ad - r2;
+  } while (q1 < delta || (q1 == delta && r1 == 0));
+  magic = (long long)(q2 + 1);
+  if (d < 0)
+    magic = -magic;
+  shift = p - 64;
+}
+
+// Emit dest = a / d or a % d for a constant d other than 0.
+static void emit_divide_by_constant(const IRInst &inst, const std::string &a,
+                                    long long d, ostream &s)
+{
+  const char *dest = locations[inst.dst].c_str();
+  bool remainder = inst.op == OP_MOD;
+  unsigned long long magnitude = d < 0 ? -(unsigned long long)d : d;
+  if (magnitude == 1)
+  {
+    if (remainder)
+    {
+      emit_mov("$0", dest, s);
+      return;
+    }
+    emit_move(a.c_str(), RAX, s);
+    if (d < 0)
+      emit_neg(RAX, s);
+    emit_move(RAX, dest, s);
+    return;
+  }
+
+  if (is_power_of_two(magnitude))
+  {
+    // Rounding toward zero: a negative dividend is biased by |d| - 1
+    // first, which is its sign bit shifted right arithmetically and then
+    // logically, to leave the low k bits set.
+    int k = log2_of(magnitude);
+    emit_move(a.c_str(), RAX, s);
+    emit_mov(RAX, RCX, s);
+    if (k > 1)
+      emit_shift(SAR, 63, RCX, s);
+    emit_shift(SHR, 64 - k, RCX, s);
+    emit_add(RCX, RAX, s);
+    if (remainder)
+    {
+      std::ostringstream mask;
+      mask << "$" << (long long)(magnitude - 1);
+      if (is_imm32(mask.str().c_str()))
+      {
+        emit_and(mask.str().c_str(), RAX, s);
+      }
+      else
+      {
+        emit_mov(mask.str().c_str(), RDX, s);
+        emit_and(RDX, RAX, s);
+      }
+      emit_sub(RCX, RAX, s);
+    }
+    else
+    {
+      emit_shift(SAR, k, RAX, s);
+      if (d < 0)
+        emit_neg(RAX, s);
+    }
+    emit_move(RAX, dest, s);
+    return;
+  }
+
+  long long magic;
+  int shift;
+  magic_divisor(d, magic, shift);
+  std::string n = a;
+  if (is_imm(n.c_str()))
+  {
+    emit_mov(n.c_str(), RCX, s);
+    n = RCX;
+  }
+  std::ostringstream m;
+  m << "$" << magic;
+  emit_mov(m.str().c_str(), RAX, s);
+  s << MUL << n << endl;
+  if (d > 0 && magic < 0)
+    emit_add(n.c_str(), RDX, s);
+  else if (d < 0 && magic > 0)
+    emit_sub(n.c_str(), RDX, s);
+  if (shift > 0)
+    emit_shift(SAR, shift, RDX, s);
+  emit_mov(RDX, RAX, s);
+  emit_shift(SHR, 63, RAX, s);
+  emit_add(RAX, RDX, s);
+  if (!remainder)
+  {
+    emit_move(RDX, dest, s);
+    return;
+  }
+  // a - (a / d) * d
+  std::ostringstream divisor;
+  divisor << "$" << d;
+  if (is_imm32(divisor.str().c_str()))
+  {
+    s << MUL << divisor.str() << COMMA << RDX << COMMA << RDX << endl;
+  }
+  else
+  {
+    emit_mov(divisor.str().c_str(), RAX, s);
+    emit_mul(RAX, RDX, s);
+  }
+  emit_move(n.c_str(), RAX, s);
+  emit_sub(RDX, RAX, s);
+  emit_move(RAX, dest, s);
+}
+
+static const char *int_op(Opcode op)
+{
+  switch (op)
+  {
+  case OP_ADD:
+    return ADD;
+  case OP_SUB:
+    return SUB;
+  case OP_MUL:
+    return MUL;
+  case OP_AND:
+    return AND;
+  case OP_OR:
+    return OR;
+  default:
+    return XOR;
+  }
+}
+
+static const char *float_op(Opcode op)
+{
+  switch (op)
+  {
+  case OP_ADD:
+    return ADDSD;
+  case OP_SUB:
+    return SUBSD;
+  case OP_MUL:
+    return MULSD;
+  default:
+    return DIVSD;
+  }
+}
+
+static void emit_arith(const IRInst &inst, ostream &s)
+{
+  std::string a = operand(inst.a);
+  std::string b = operand(inst.b);
+  const std::string &dest = locations[inst.dst];
+  if (inst.type == IR_FLOAT)
+  {
+    const char *acc = is_xmm(dest.c_str()) && dest != b ? dest.c_str() : XMM0;
+    emit_move(a.c_str(), acc, s);
+    s << float_op(inst.op) << b << COMMA << acc << endl;
+    emit_move(acc, dest.c_str(), s);
+    return;
+  }
+  // A commutative operation takes its constant, or the operand that is
+  // also its destination, on the left.
+  if (inst.op != OP_SUB && (is_imm(a.c_str()) || b == dest) && !is_imm(b.c_str()))
+    std::swap(a, b);
+  if (inst.op == OP_MUL && is_imm(b.c_str()) && !is_imm(a.c_str()) &&
+      emit_multiply_by_constant(a, strtoll(b.c_str() + 1, NULL, 0), dest, s))
+    return;
+  if (is_imm(b.c_str()) && !is_imm32(b.c_str()))
+  {
+    emit_mov(b.c_str(), RCX, s);
+    b = RCX;
+  }
+  if (dest == a && !(is_mem(dest.c_str()) && (inst.op == OP_MUL || is_mem(b.c_str()))))
+  {
+    // in place, in a register or a stack slot
+    s << int_op(inst.op) << b << COMMA << dest << endl;
+    return;
+  }
+  const char *acc = is_mem(dest.c_str()) || dest == b ? RAX : dest.c_str();
+  if (is_imm(b.c_str()) && !is_imm(a.c_str()))
+  {
+    if (inst.op == OP_MUL)
+    {
+      // the three-operand imulq takes its source from anywhere
+      s << MUL << b << COMMA << a << COMMA << acc << endl;
+      emit_move(acc, dest.c_str(), s);
+      return;
+    }
+    long long value = strtoll(b.c_str() + 1, NULL, 0);
+    if ((inst.op == OP_ADD || (inst.op == OP_SUB && value != INT_MIN)) &&
+        !is_mem(a.c_str()) && !is_mem(dest.c_str()))
+    {
+      s << LEA << (inst.op == OP_ADD ? value : -value) << "(" << a << ")" << COMMA
+        << dest << endl;
+      return;
+    }
+  }
+  emit_move(a.c_str(), acc, s);
+  s << int_op(inst.op) << b << COMMA << acc << endl;
+  emit_move(acc, dest.c_str(), s);
+}
+
+static void emit_divide(const IRInst &inst, ostream &s)
+{
+  std::string b = operand(inst.b);
+  if (inst.b.kind == Operand::INT && inst.b.ival != 0)
+  {
+    emit_divide_by_constant(inst, operand(inst.a), inst.b.ival, s);
+    return;
+  }
+  emit_move(operand(inst.a), RAX, s);
+  emit_cqto(s);
+  if (is_imm(b.c_str()))
+  {
+    emit_mov(b.c_str(), RCX, s);
+    b = RCX;
+  }
+  emit_div(b.c_str(), s);
+  emit_move(inst.op == OP_MOD ? RDX : RAX, locations[inst.dst].c_str(), s);
+}
+
+static void emit_unary(const IRInst &inst, ostream &s)
+{
+  std::string a = operand(inst.a);
+  const char *dest = locations[inst.dst].c_str();
+  if (inst.op == OP_NEG && inst.type == IR_FLOAT)
+  {
+    // flip the sign bit
+    emit_move(a.c_str(), RAX, s);
+    s << BTC << "$63" << COMMA << RAX << endl;
+    emit_move(RAX, dest, s);
+    return;
+  }
+  emit_move(a.c_str(), dest, s);
+  if (inst.op == OP_NEG)
+    emit_neg(dest, s);
+  else if (inst.type == IR_BOOL)
+    emit_xor("$1", dest, s);
+  else
+    emit_not(dest, s);
+}
+
+static void emit_int_to_float(const IRInst &inst, ostream &s)
+{
+  std::string a = operand(inst.a);
+  const char *dest = locations[inst.dst].c_str();
+  if (is_imm(a.c_str()))
+  {
+    emit_mov(a.c_str(), RAX, s);
+    a = RAX;
+  }
+  const char *xmm = is_xmm(dest) ? dest : XMM0;
+  emit_int_to_float(a.c_str(), xmm, s);
+  emit_move(xmm, dest, s);
+}
+
+static void emit_call(const IRInst &inst, ostream &s)
+{
+  // Arguments that do not fit in registers go to the bottom of the
+  // frame, in order, where the callee finds them above its return address.
+  int intnumber = 0;
+  int floatnumber = 0;
+  int stack_arg = 0;
+  for (size_t i = 0; i < inst.args.size(); i++)
+  {
+    std::string arg = operand(inst.args[i]);
+    if (is_float_operand(inst.args[i]))
+    {
+      if (floatnumber < CALL_XMM_NUM)
+      {
+        emit_move(arg.c_str(), CALL_XMM[floatnumber++], s);
+        continue;
+      }
+    }
+    else if (intnumber < CALL_REGS_NUM)
+    {
+      emit_move(arg.c_str(), CALL_REGS[intnumber++], s);
+      continue;
+    }
+    emit_move(arg.c_str(), RAX, s);
+    emit_rmmov(RAX, stack_arg, RSP, s);
+    stack_arg += 8;
+  }
+
+  if (inst.name == print)
+  {
+    s << MOVL << "$" << floatnumber << COMMA << EAX << endl;
+  }
+  emit_call(inst.name->get_string(), s);
+  if (inst.dst >= 0)
+    emit_move(inst.type == IR_FLOAT ? XMM0 : RAX, locations[inst.dst].c_str(), s);
+}
+
+//
+// Comparisons
+//
+// An Int, Bool or String comparison is a cmpq, or a testq against 0, and
+// a signed conditional jump.  A Float comparison is a ucomisd.  ucomisd
+// sets ZF, PF and CF when either operand is a NaN, and a NaN satisfies no
+// relation but !=.  Turning < and <= around into > and >= makes every
+// relation hold only with CF clear, so ja / jae are false for a NaN and
+// their inverses jbe / jb true; == and != also look at PF.
+//
+
+// The relation that holds for b and a when rel holds for a and b.
+static Relation mirror(Relation rel)
+{
+  static const Relation mirrored[] = {REL_GT, REL_GE, REL_EQ, REL_NE, REL_LE, REL_LT};
+  return mirrored[rel];
+}
+
+// Set the flags for "a rel b" and return the relation to test them for.
+static Relation emit_compare(const IRInst &inst, ostream &s)
+{
+  std::string a = operand(inst.a);
+  std::string b = operand(inst.b);
+  Relation rel = inst.rel;
+  if (inst.type == IR_FLOAT)
+  {
+    if (rel == REL_LT || rel == REL_LE)
+    {
+      std::swap(a, b);
+      rel = mirror(rel);
+    }
+    if (!is_xmm(a.c_str()))
+    {
+      emit_move(a, XMM0, s);
+      a = XMM0;
+    }
+    emit_ucompisd(b.c_str(), a.c_str(), s);
+    return rel;
+  }
+
+  if (is_imm(a.c_str()) && !is_imm(b.c_str()))
+  {
+    std::swap(a, b);
+    rel = mirror(rel);
+  }
+  if (b == "$0" && !is_mem(a.c_str()) && !is_imm(a.c_str()))
+  {
+    emit_test(a.c_str(), a.c_str(), s);
+    return rel;
+  }
+  if (is_imm(a.c_str()) || (is_mem(a.c_str()) && is_mem(b.c_str())))
+  {
+    emit_mov(a.c_str(), RAX, s);
+    a = RAX;
+  }
+  if (is_imm(b.c_str()) && !is_imm32(b.c_str()))
+  {
+    emit_mov(b.c_str(), RCX, s);
+    b = RCX;
+  }
+  emit_cmp(b.c_str(), a.c_str(), s);
+  return rel;
+}
+
+// Jump to label when the flags set by emit_compare say that rel is jump_if.
+static void emit_cond_jump(IRType type, Relation rel, bool jump_if, int label, ostream &s)
+{
+  static const char *int_true[] = {JL, JLE, JE, JNE, JGE, JG};
+  static const char *int_false[] = {JGE, JG, JNE, JE, JL, JLE};
+  if (type != IR_FLOAT)
+    emit_branch(jump_if ? int_true[rel] : int_false[rel], label, s);
+  else if (rel == REL_GT)
+    emit_branch(jump_if ? JA : JBE, label, s);
+  else if (rel == REL_GE)
+    emit_branch(jump_if ? JAE : JB, label, s);
+  else if ((rel == REL_EQ) == jump_if)
+  {
+    // equal: ZF set and PF clear
+    int skip = num_label++;
+    emit_branch(JP, skip, s);
+    emit_branch(JE, label, s);
+    emit_label(skip, s);
+  }
+  else
+  {
+    emit_branch(JNE, label, s);
+    emit_branch(JP, label, s);
+  }
+}
+
+// The condition code of a setcc or cmovcc true when the flags set by
+// emit_compare say rel holds; for a Float == or != also mind PF.
+static const char *condition_code(IRType type, Relation rel)
+{
+  static const char *int_cc[] = {"l", "le", "e", "ne", "ge", "g"};
+  static const char *float_cc[] = {"b", "be", "e", "ne", "ae", "a"};
+  return type == IR_FLOAT ? float_cc[rel] : int_cc[rel];
+}
+
+// dst = a rel b, as 0 or 1 without a branch.
+static void emit_compare_value(const IRInst &inst, ostream &s)
+{
+  const char *dest = locations[inst.dst].c_str();
+  Relation rel = emit_compare(inst, s);
+  s << SET << condition_code(inst.type, rel) << "\t" << AL << endl;
+  if (inst.type == IR_FLOAT && rel == REL_EQ)
+  {
+    s << SET << "np\t" << CL << endl;
+    s << ANDB << CL << COMMA << AL << endl;
+  }
+  else if (inst.type == IR_FLOAT && rel == REL_NE)
+  {
+    s << SET << "p\t" << CL << endl;
+    s << ORB << CL << COMMA << AL << endl;
+  }
+  if (is_mem(dest))
+  {
+    s << MOVZBQ << AL << COMMA << RAX << endl;
+    emit_mov(RAX, dest, s);
+  }
+  else
+  {
+    s << MOVZBQ << AL << COMMA << dest << endl;
+  }
+}
+
+//
+// dst = a rel b ? args[0] : args[1], without a branch.  The value if false
+// goes to dst, or to %rdx when dst is in memory or holds the value if
+// true, and the value if true over it when the flags say so.  cmov takes
+// no immediate, so one goes through %rax or %rcx, which emit_compare is
+// done with by then.  Moves leave the flags alone.
+//
+static void emit_select(const IRInst &inst, ostream &s)
+{
+  Relation rel = emit_compare(inst, s);
+  std::string dest = locations[inst.dst];
+  std::string if_true = operand(inst.args[0]);
+  std::string if_false = operand(inst.args[1]);
+  std::string result = is_mem(dest.c_str()) || if_true == dest ? RDX : dest;
+  emit_move(if_false, result, s);
+  if (is_imm(if_true.c_str()))
+  {
+    emit_mov(if_true.c_str(), RAX, s);
+    if_true = RAX;
+  }
+  s << CMOV << condition_code(inst.type, rel) << "\t" << if_true << COMMA << result << endl;
+  if (inst.type == IR_FLOAT && (rel == REL_EQ || rel == REL_NE))
+  {
+    // A NaN operand: == is false and != true.
+    std::string unordered = rel == REL_EQ ? if_false : if_true;
+    if (is_imm(unordered.c_str()))
+    {
+      emit_mov(unordered.c_str(), RCX, s);
+      unordered = RCX;
+    }
+    s << CMOV << "p\t" << unordered << COMMA << result << endl;
+  }
+  emit_move(result, dest, s);
+}
+
+// Emit the terminator of the block at index i of the layout.
+static void emit_terminator(const IRInst &inst, size_t i, ostream &s)
+{
+  BasicBlock *next = i + 1 < fn->blocks.size() ? fn->blocks[i + 1] : NULL;
+  switch (inst.op)
+  {
+  case OP_JMP:
+    if (inst.target[0] != next)
+      emit_branch(JMP, block_label[inst.target[0]->id], s);
+    break;
+  case OP_CBR:
+  {
+    Relation rel = emit_compare(inst, s);
+    if (inst.target[1] == next)
+    {
+      emit_cond_jump(inst.type, rel, true, block_label[inst.target[0]->id], s);
+      break;
+    }
+    emit_cond_jump(inst.type, rel, false, block_label[inst.target[1]->id], s);
+    if (inst.target[0] != next)
+      emit_branch(JMP, block_label[inst.target[0]->id], s);
+    break;
+  }
+  default:
+    if (inst.a.kind != Operand::NONE)
+      emit_move(operand(inst.a).c_str(), inst.type == IR_FLOAT ? XMM0 : RAX, s);
+    // The last block falls into the epilogue.
+    if (next != NULL)
+      emit_branch(JMP, return_pos, s);
+    break;
+  }
+}
+
+static void emit_inst(const IRInst &inst, ostream &s)
+{
+  switch (inst.op)
+  {
+  case OP_MOV:
+    emit_move(operand(inst.a), locations[inst.dst], s);
+    break;
+  case OP_ADD:
+  case OP_SUB:
+  case OP_MUL:
+  case OP_AND:
+  case OP_OR:
+  case OP_XOR:
+    emit_arith(inst, s);
+    break;
+  case OP_DIV:
+    if (inst.type == IR_FLOAT)
+      emit_arith(inst, s);
+    else
+      emit_divide(inst, s);
+    break;
+  case OP_MOD:
+    emit_divide(inst, s);
+    break;
+  case OP_NEG:
+  case OP_NOT:
+    emit_unary(inst, s);
+    break;
+  case OP_I2F:
+    emit_int_to_float(inst, s);
+    break;
+  case OP_CMP:
+    emit_compare_value(inst, s);
+    break;
+  case OP_SELECT:
+    emit_select(inst, s);
+    break;
+  case OP_LOAD:
+    emit_move(std::string(inst.name->get_string()) + "(" + RIP + ")", locations[inst.dst], s);
+    break;
+  case OP_STORE:
+    emit_move(operand(inst.a), std::string(inst.name->get_string()) + "(" + RIP + ")", s);
+    break;
+  case OP_CALL:
+    emit_call(inst, s);
+    break;
+  default:
+    break;
+  }
+}
+
+// Move the parameters from where the caller passed them to their vregs.
+static void emit_params(ostream &s)
+{
+  int intnumber = 0;
+  int floatnumber = 0;
+  int stack_param = 16;
+  for (size_t i = 0; i < fn->params.size(); i++)
+  {
+    int v = fn->params[i];
+    std::string source;
+    if (is_float_vreg(v) && floatnumber < CALL_XMM_NUM)
+    {
+      source = CALL_XMM[floatnumber++];
+    }
+    else if (!is_float_vreg(v) && intnumber < CALL_REGS_NUM)
+    {
+      source = CALL_REGS[intnumber++];
+    }
+    else
+    {
+      // passed on the stack, above the return address
+      std::ostringstream param;
+      param << stack_param << "(" << RBP << ")";
+      source = param.str();
+      stack_param += 8;
+    }
+    // an unused parameter has no location
+    if (!locations[v].empty())
+      emit_move(source, locations[v], s);
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Memoization
+//
+// A memoized function is entered through a wrapper that looks its
+// arguments up in a table of the results computed so far, and only calls
+// the function's own code, at name.uncached, on a miss.  Recursive calls
+// go through the wrapper too.  The table is open addressed with a few
+// linear probes from the slot the arguments hash to; when those are all
+// taken, the first is overwritten, so it never grows.  A slot holds the
+// arguments' bits, the result, and whether it is in use:
+//
+//      | key 0 | ... | key n-1 | result | full |       8 bytes each
+//
+// The hits and misses of every table are printed to stderr at exit.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+static const int MEMO_LOG2_SLOTS = 12;
+static const int MEMO_PROBES = 4;
+
+struct MemoTable
+{
+  Symbol name;
+  int label;                            // of .MEMO<label> and its counters
+  int slot_size;
+};
+
+static std::vector<MemoTable> memo_tables;
+
+// The register each parameter of fn arrives in, by emit_params' rules.
+static void param_registers(std::vector<const char *> &regs)
+{
+  int intnumber = 0, floatnumber = 0;
+  for (size_t i = 0; i < fn->params.size(); i++)
+    regs.push_back(is_float_vreg(fn->params[i]) ? CALL_XMM[floatnumber++]
+                                                : CALL_REGS[intnumber++]);
+}
+
+static void emit_memo_wrapper(ostream &s)
+{
+  std::vector<const char *> keys;
+  param_registers(keys);
+  MemoTable table;
+  table.name = fn->name;
+  table.label = num_label++;
+  table.slot_size = 8 * (keys.size() + 2);
+  memo_tables.push_back(table);
+  int result = 8 * keys.size(), full = result + 8;
+  bool float_result = fn->ret_type == IR_FLOAT;
+
+  // the slot: Fibonacci hashing of the keys, one after the other
+  s << "\tmovabsq\t$-7046029254386353131" << COMMA << R11 << endl;   // 2^64 / phi
+  s << XOR << RAX << COMMA << RAX << endl;
+  for (size_t i = 0; i < keys.size(); i++)
+  {
+    if (keys[i][1] == 'x')
+    {
+      emit_mov(keys[i], R10, s);
+      s << XOR << R10 << COMMA << RAX << endl;
+    }
+    else
+      s << XOR << keys[i] << COMMA << RAX << endl;
+    s << MUL << R11 << COMMA << RAX << endl;
+  }
+  s << SHR << "$" << 64 - MEMO_LOG2_SLOTS << COMMA << RAX << endl
+    << MUL << "$" << table.slot_size << COMMA << RAX << COMMA << RAX << endl
+    << LEA << MEMO_PREFIX << table.label << "(" << RIP << ")" << COMMA << R10 << endl
+    << ADD << RAX << COMMA << R10 << endl
+    << MOV << "$" << MEMO_PROBES << COMMA << R11 << endl;
+
+  int probe = num_label++, next = num_label++, miss = num_label++;
+  emit_label(probe, s);
+  s << CMP << "$0" << COMMA << full << "(" << R10 << ")" << endl;
+  emit_branch(JE, miss, s);
+  for (size_t i = 0; i < keys.size(); i++)
+  {
+    const char *key = keys[i];
+    if (keys[i][1] == 'x')
+    {
+      emit_mov(keys[i], RAX, s);
+      key = RAX;
+    }
+    s << CMP << key << COMMA << 8 * i << "(" << R10 << ")" << endl;
+    emit_branch(JNE, next, s);
+  }
+  s << "\tincq\t" << MEMO_PREFIX << table.label << "h(" << RIP << ")" << endl
+    << (float_result ? MOVSD : MOV) << result << "(" << R10 << ")" << COMMA
+    << (float_result ? XMM0 : RAX) << endl;
+  emit_ret(s);
+  emit_label(next, s);
+  s << ADD << "$" << table.slot_size << COMMA << R10 << endl
+    << "\tdecq\t" << R11 << endl;
+  emit_branch(JNZ, probe, s);
+  s << SUB << "$" << MEMO_PROBES * table.slot_size << COMMA << R10 << endl;
+
+  // a miss: call the function itself, with the arguments as they came,
+  // and fill the slot from what was saved of them
+  emit_label(miss, s);
+  s << "\tincq\t" << MEMO_PREFIX << table.label << "m(" << RIP << ")" << endl;
+  emit_push(RBP, s);
+  emit_mov(RSP, RBP, s);
+  emit_push(R10, s);
+  for (size_t i = 0; i < keys.size(); i++)
+  {
+    emit_mov(keys[i], RAX, s);
+    emit_push(RAX, s);
+  }
+  if (keys.size() % 2 == 0)
+    s << SUB << "$8" << COMMA << RSP << endl;
+  s << CALL << fn->name << MEMO_BODY_SUFFIX << endl;
+  s << MOV << "-8(" << RBP << ")" << COMMA << R10 << endl;
+  for (size_t i = 0; i < keys.size(); i++)
+    s << MOV << -16 - 8 * (int)i << "(" << RBP << ")" << COMMA << R11 << endl
+      << MOV << R11 << COMMA << 8 * i << "(" << R10 << ")" << endl;
+  s << (float_result ? MOVSD : MOV) << (float_result ? XMM0 : RAX) << COMMA
+    << result << "(" << R10 << ")" << endl
+    << MOV << "$1" << COMMA << full << "(" << R10 << ")" << endl;
+  emit_leave(s);
+  emit_ret(s);
+}
+
+void emit_memo_tables(ostream &s)
+{
+  if (memo_tables.empty())
+    return;
+  s << SECTION << RODATA_STR << endl
+    << MEMO_PREFIX << "f:" << endl
+    << STRINGTAG << "\"memo %s: %lld hits, %lld misses\\n\"" << endl;
+  for (size_t i = 0; i < memo_tables.size(); i++)
+    s << MEMO_PREFIX << memo_tables[i].label << "s:" << endl
+      << STRINGTAG << "\"" << memo_tables[i].name << "\"" << endl;
+
+  s << BSS << endl
+    << ALIGN << 8 << endl;
+  for (size_t i = 0; i < memo_tables.size(); i++)
+  {
+    const MemoTable &table = memo_tables[i];
+    int slots = (1 << MEMO_LOG2_SLOTS) + MEMO_PROBES - 1;
+    s << MEMO_PREFIX << table.label << ":" << endl
+      << "\t.zero\t" << slots * table.slot_size << endl
+      << MEMO_PREFIX << table.label << "h:" << endl
+      << "\t.zero\t8" << endl
+      << MEMO_PREFIX << table.label << "m:" << endl
+      << "\t.zero\t8" << endl;
+  }
+
+  s << TEXT << endl
+    << MEMO_PREFIX << "r:" << endl;
+  emit_push(RBP, s);
+  emit_mov(RSP, RBP, s);
+  for (size_t i = 0; i < memo_tables.size(); i++)
+  {
+    int label = memo_tables[i].label;
+    s << MOV << "stderr(" << RIP << ")" << COMMA << RDI << endl
+      << MOV << "$" << MEMO_PREFIX << "f" << COMMA << RSI << endl
+      << MOV << "$" << MEMO_PREFIX << label << "s" << COMMA << RDX << endl
+      << MOV << MEMO_PREFIX << label << "h(" << RIP << ")" << COMMA << RCX << endl
+      << MOV << MEMO_PREFIX << label << "m(" << RIP << ")" << COMMA << R8 << endl
+      << XOR << RAX << COMMA << RAX << endl;
+    emit_call("fprintf", s);
+  }
+  emit_leave(s);
+  emit_ret(s);
+  s << SECTION << FINI_ARRAY << endl
+    << ALIGN << 8 << endl
+    << INTTAG << MEMO_PREFIX << "r" << endl;
+}
+
+void emit_function(IRFunction &f, ostream &s)
+{
+  fn = &f;
+  allocate_vregs();
+  return_pos = num_label++;
+  block_label.assign(fn->all_blocks.size(), -1);
+  for (size_t i = 0; i < fn->blocks.size(); i++)
+    block_label[fn->blocks[i]->id] = num_label++;
+
+  std::ostringstream body_code;
+  emit_params(body_code);
+  for (size_t i = 0; i < fn->blocks.size(); i++)
+  {
+    // A block needs its label if it is reached other than by falling
+    // through from the block before.  One to be aligned starts a fresh
+    // 16-byte fetch block, unless that takes more than 10 bytes of padding.
+    BasicBlock *bb = fn->blocks[i];
+    if (bb->align)
+      body_code << P2ALIGN << "4,,10" << endl;
+    for (size_t k = 0; k < bb->preds.size(); k++)
+    {
+      if (i == 0 || bb->preds[k] != fn->blocks[i - 1])
+      {
+        emit_label(block_label[bb->id], body_code);
+        break;
+      }
+    }
+    for (size_t k = 0; k + 1 < bb->insts.size(); k++)
+      emit_inst(bb->insts[k], body_code);
+    emit_terminator(bb->terminator(), i, body_code);
+  }
+  emit_epilogue(body_code);
+
+  s << GLOBAL << fn->name << endl
+    << SYMBOL_TYPE << fn->name << COMMA << FUNCTION << endl
+    << fn->name << ":" << endl;
+  if (fn->memoized)
+  {
+    emit_memo_wrapper(s);
+    s << fn->name << MEMO_BODY_SUFFIX << ":" << endl;
+  }
+  emit_prologue(s);
+  InsnBuffer body;
+  body.parse(body_code.str());
+  if (cgen_optimize)
+    body.optimize();
+  body.print(s);
+  s << SIZE << fn->name << ", "
+    << ".-" << fn->name << endl;
+}
+
+void emit_float_constants(ostream &s)
+{
+  if (float_constants.empty())
+    return;
+  s << SECTION << RODATA << endl
+    << ALIGN << 8 << endl;
+  std::vector<unsigned long long> bits(float_constants.size());
+  for (std::map<unsigned long long, int>::iterator it = float_constants.begin();
+       it != float_constants.end(); ++it)
+    bits[it->second] = it->first;
+  for (size_t k = 0; k < bits.size(); k++)
+    s << FLOATCONST_PREFIX << k << ":" << endl
+      << INTTAG << "0x" << std::hex << bits[k] << std::dec << endl;
+}
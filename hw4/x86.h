@@ -0,0 +1,21 @@
+#ifndef _X86_H_
+#define _X86_H_
+
+#include "seal-io.h"
+#include "ir.h"
+
+//
+// The x86-64 backend: instruction selection, register allocation and frame
+// layout for one IR function, whose preds and succs are up to date.  Emits
+// the whole function, from its .globl to its .size.
+//
+void emit_function(IRFunction &fn, ostream &s);
+
+// The .rodata pool of the Float constants the functions emitted so far use.
+void emit_float_constants(ostream &s);
+
+// The caches of the memoized functions emitted so far, and the code that
+// reports their hits and misses at exit.
+void emit_memo_tables(ostream &s);
+
+#endif